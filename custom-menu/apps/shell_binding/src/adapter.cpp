@@ -34,7 +34,7 @@ void shell_script_adapter::run_process(const std::optional<std::string> &arg) {
   process_start_time = std::chrono::steady_clock::now();
 
   if (poll_timer_id == 0)
-    poll_timer_id = controller_api->schedule_timer(100, true, [this] { poll_process(); });
+    poll_timer_id = controller_api->schedule_timer(100, true, [this] { poll_process(); }, 50);
 }
 
 void shell_script_adapter::add_deferred_items(std::vector<std::string> &deferred_items) {
@@ -175,6 +175,7 @@ void shell_script_adapter::shutdown_process() {
         (void) old_process->kill();
       }
     };
-    controller_api->schedule_timer(1000, false, std::move(lambda));
+    // No rush, the SIGKILL can wait for whatever wakes us up next
+    controller_api->schedule_timer(1000, false, std::move(lambda), 500);
   }
 }
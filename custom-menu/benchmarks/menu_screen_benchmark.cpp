@@ -0,0 +1,114 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "clay_fb_renderer.hpp"
+#include "fonts/poppins_12.hpp"
+#include "fonts/poppins_8.hpp"
+#include "ui/actions/button.hpp"
+#include "ui/actions/label.hpp"
+#include "ui/actions/page_break.hpp"
+#include "ui/screens/menu_screen.hpp"
+
+// Lays out and renders a large menu screen the way the display controller does, without rasterizing it
+
+static const BitmapFont *fonts_by_id[] = { &fonts::Poppins_12, &fonts::Poppins_8 };
+static TextMeasureCache text_measure_cache;
+static size_t render_commands = 0;
+
+display_mode_t app_api_get_display_mode(c_app_api_t) {
+  return DISPLAY_MODE_BGR565;
+}
+
+size_t app_api_get_screen_width(c_app_api_t) {
+  return 128;
+}
+
+size_t app_api_get_screen_height(c_app_api_t) {
+  return 128;
+}
+
+uint16_t app_api_get_font(c_app_api_t, const char *font_name, const int font_size) {
+  for (uint16_t id = 0; id < std::size(fonts_by_id); id++) {
+    if (std::string_view(fonts_by_id[id]->name) == font_name && fonts_by_id[id]->size == font_size)
+      return id;
+  }
+  return FONT_NOT_FOUND;
+}
+
+uint32_t app_api_get_font_generation(c_app_api_t) {
+  return 1;
+}
+
+void app_api_clay_render(app_api_t, const Clay_RenderCommandArray *cmds) {
+  Clay_UpdateScrollContainers(false, Clay_Vector2{ 0, 0 }, 0);
+  render_commands += cmds->length;
+}
+
+measure_text_result_t app_api_clay_measure_text(app_api_t,
+                                                const char *text,
+                                                const size_t length,
+                                                Clay_TextElementConfig *config) {
+  const auto [width, height] =
+    text_measure_cache.measure(*fonts_by_id[config->fontId], config->fontId, std::string_view(text, length));
+  return { static_cast<float>(width), static_cast<float>(height) };
+}
+
+static void clay_error(Clay_ErrorData error) {
+  fprintf(stderr, "Clay error: %.*s\n", error.errorText.length, error.errorText.chars);
+}
+
+static Clay_Dimensions measure_text(Clay_StringSlice text, Clay_TextElementConfig *config, void *) {
+  const auto [width, height] = app_api_clay_measure_text(nullptr, text.chars, text.length, config);
+  return { width, height };
+}
+
+template<typename Frame>
+static double time_frames(const int frames, Frame &&frame) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < frames; i++)
+    frame();
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / frames;
+}
+
+int main(const int argc, char **argv) {
+  const int entries = argc > 1 ? std::atoi(argv[1]) : 1000;
+  const int frames = argc > 2 ? std::atoi(argv[2]) : 300;
+
+  const uint32_t arena_size = Clay_MinMemorySize();
+  Clay_Initialize(Clay_CreateArenaWithCapacityAndMemory(arena_size, malloc(arena_size)),
+                  { 128, 128 },
+                  { .errorHandlerFunction = &clay_error });
+  Clay_SetMeasureTextFunction(&measure_text, nullptr);
+
+  // A page break every 20 entries, and some entries long enough to wrap
+  ui::screens::menu_screen::actions_vector_t actions;
+  for (int i = 0; i < entries; i++) {
+    if (i % 20 == 19)
+      actions.emplace_back(std::make_unique<ui::actions::page_break>());
+    else if (i % 7 == 3)
+      actions.emplace_back(
+        std::make_unique<ui::actions::label>("Entry " + std::to_string(i) + " has a long text that wraps", true));
+    else
+      actions.emplace_back(std::make_unique<ui::actions::button>("Entry " + std::to_string(i), [] {}));
+  }
+
+  // The API is only a handle passed back to the functions above
+  display_controller_api controller_api;
+  ui::screens::menu_screen screen(actions, "Benchmark");
+  screen.render(controller_api);
+
+  const double scroll_us = time_frames(frames, [&] { screen.handle_keypress(controller_api, BUTTON_MENU); });
+  const double relayout_us = time_frames(frames, [&] {
+    screen.invalidate_layout();
+    screen.render(controller_api);
+  });
+
+  const auto [hits, misses] = text_measure_cache.stats();
+  printf("%d entries, %d frames\n", entries, frames);
+  printf("scroll:   %8.1f us/frame\n", scroll_us);
+  printf("relayout: %8.1f us/frame\n", relayout_us);
+  printf("%zu render commands, %u text measure cache hits, %u misses\n", render_commands, hits, misses);
+  return 0;
+}
@@ -10,6 +10,45 @@ from pathlib import Path
 import yaml
 from PIL import Image, ImageDraw, ImageFont
 
+# Glyph lookup is limited to the Basic Multilingual Plane, split into 256 pages of 256 codepoints
+MAX_CODEPOINT = 0xFFFF
+PAGE_SIZE = 256
+PAGE_COUNT = (MAX_CODEPOINT + 1) // PAGE_SIZE
+
+# Glyph used for codepoints that are not in the font
+FALLBACK_CHAR = "?"
+
+
+def parse_range(spec) -> range:
+    """Parse a codepoint range such as "0xA0-0xFF", "0x400-0x45F" or a single codepoint."""
+    if isinstance(spec, int):
+        return range(spec, spec + 1)
+    lo, _, hi = str(spec).partition("-")
+    lo = int(lo, 0)
+    hi = int(hi, 0) if hi else lo
+    if lo > hi or hi > MAX_CODEPOINT:
+        raise ValueError(f"Invalid codepoint range: {spec}")
+    return range(lo, hi + 1)
+
+
+def glyph_key(font, ch: str):
+    mask = font.getmask(ch, mode="L")
+    return mask.size, bytes(mask), font.getlength(ch)
+
+
+def write_u16_array(f, name: str, values: list[int]):
+    f.write(f"inline constexpr std::uint16_t {name}[{len(values)}] = {{\n")
+    line = "    "
+    for v in values:
+        token = f"{v}, "
+        if len(line) + len(token) > 80:
+            f.write(line + "\n")
+            line = "    "
+        line += token
+    if line.strip():
+        f.write(line + "\n")
+    f.write("};\n\n")
+
 
 def main():
     parser = argparse.ArgumentParser()
@@ -24,6 +63,12 @@ def main():
         default="□",
         help="Glyph used for control chars (ASCII < 32 or 127)",
     )
+    parser.add_argument(
+        "--codepoints",
+        action="append",
+        default=[],
+        help="Extra codepoint range to include, e.g. 0xA0-0xFF (may be repeated)",
+    )
     parser.add_argument("--overrides", type=Path, help="Path to glyph_overrides.yaml")
     parser.add_argument("--preview", type=Path, help="Path to output preview PNG")
     args = parser.parse_args()
@@ -32,6 +77,17 @@ def main():
     ascent, descent = font.getmetrics()
     line_gap = int(args.size * 0.2)
 
+    # ASCII is always present, control codes render as the replacement glyph
+    codepoints = set(range(128))
+    # Requested ranges by name, to report the ones the fonts don't cover at all
+    named_ranges = []
+    for spec in args.codepoints:
+        codepoints.update(parse_range(spec))
+        named_ranges.append((spec, set(parse_range(spec))))
+
+    # Codepoints rendered from a source font other than the main one
+    range_sources = {}
+
     overrides_map = {}
     if args.overrides:
         with args.overrides.open("r", encoding="utf-8") as f:
@@ -47,17 +103,31 @@ def main():
             source_defaults[src_name]["verticalOffset"] = src_cfg["ttf"].get("verticalOffset", 0)
             source_defaults[src_name]["horizontalOffset"] = src_cfg["ttf"].get("horizontalOffset", 0)
 
+        for rng in overrides_data.get("codepoints", []):
+            cps = parse_range(rng["range"])
+            codepoints.update(cps)
+            named_ranges.append((rng.get("name", rng["range"]), set(cps)))
+            if "source" in rng:
+                src = {
+                    "font": source_fonts[rng["source"]],
+                    "verticalOffset": source_defaults[rng["source"]].get("verticalOffset", 0),
+                    "horizontalOffset": source_defaults[rng["source"]].get("horizontalOffset", 0),
+                }
+                range_sources.update((cp, src) for cp in cps)
+
         for ov in overrides_data.get("overrides", []):
-            if chr(ov["target"]).isprintable():
-                warnings.warn(
-                    f"Overriding printable character {ov['target']} ({chr(ov['target'])})"
-                )
+            # Symbols live at their source codepoint (usually in the Private Use Area) unless remapped
+            target = ov.get("target", ov["replacement"])
+            if target > MAX_CODEPOINT:
+                raise ValueError(f"Override {ov['name']} targets U+{target:X}, outside the BMP")
+            if target in codepoints and chr(target).isprintable():
+                warnings.warn(f"Overriding printable character {target} ({chr(target)})")
 
             # Determine vertical offset: override > source default > 0
             v_offset = ov.get("verticalOffset", source_defaults[ov["source"]].get("verticalOffset", 0))
             h_offset = ov.get("horizontalOffset", source_defaults[ov["source"]].get("horizontalOffset", 0))
 
-            overrides_map[ov["target"]] = {
+            overrides_map[target] = {
                 "name": ov["name"],
                 "replacement": ov["replacement"],
                 "font": source_fonts[ov["source"]],
@@ -117,7 +187,20 @@ def main():
             "bitmap": bytes(bmp),
         }
 
-    for code in range(128):
+    codepoints.update(overrides_map.keys())
+    codepoints = sorted(cp for cp in codepoints if cp <= MAX_CODEPOINT)
+
+    # Codepoints a font doesn't cover render as its .notdef box; detect those and leave them to the fallback glyph
+    notdef_keys = {}
+
+    def is_missing(ch: str, font_to_use) -> bool:
+        if font_to_use not in notdef_keys:
+            notdef_keys[font_to_use] = glyph_key(font_to_use, "\uffff")
+        return glyph_key(font_to_use, ch) == notdef_keys[font_to_use]
+
+    missing = []
+    glyph_index = {}
+    for code in codepoints:
         if code in overrides_map:
             ov = overrides_map[code]
             ch = chr(ov["replacement"])
@@ -129,10 +212,24 @@ def main():
         elif code < 32 or code == 127:
             ch = rep_char
             g = render_char(ch)
+        elif code in range_sources:
+            src = range_sources[code]
+            ch = chr(code)
+            if is_missing(ch, src["font"]):
+                missing.append(code)
+                continue
+            g = render_char(
+                ch, font_to_use=src["font"], vertical_offset=src["verticalOffset"],
+                horizontal_offset=src["horizontalOffset"]
+            )
         else:
             ch = chr(code)
+            if code >= 128 and is_missing(ch, font):
+                missing.append(code)
+                continue
             g = render_char(ch)
 
+        glyph_index[code] = len(glyphs)
         key = (
             g["width"],
             g["height"],
@@ -160,6 +257,24 @@ def main():
             }
         )
 
+    # Gaps in a range are expected and use the fallback glyph, a range with no glyph at all is most likely a mistake
+    missing_set = set(missing)
+    for range_name, cps in named_ranges:
+        if cps and cps <= missing_set:
+            warnings.warn(f"{range_name}: none of the {len(cps)} requested codepoints have a glyph")
+
+    # Two-level page table over the BMP: page_table[cp >> 8] selects a page of 256 glyph indices. Page 0 is shared by
+    # all codepoints without a glyph and maps them to the fallback glyph.
+    fallback = glyph_index[ord(FALLBACK_CHAR)]
+    page_table = [0] * PAGE_COUNT
+    pages = [[fallback] * PAGE_SIZE]
+    for code, idx in glyph_index.items():
+        page = code // PAGE_SIZE
+        if page_table[page] == 0:
+            page_table[page] = len(pages)
+            pages.append([fallback] * PAGE_SIZE)
+        pages[page_table[page]][code % PAGE_SIZE] = idx
+
     # Emit header
     var_base = f"{args.name}_{args.size}".replace("-", "_")
 
@@ -186,7 +301,7 @@ def main():
         f.write("};\n\n")
 
         # Glyphs
-        f.write(f"inline constexpr Glyph {var_base}_glyphs[128] = {{\n")
+        f.write(f"inline constexpr Glyph {var_base}_glyphs[{len(glyphs)}] = {{\n")
         f.write("  // clang-format off\n")
         for g in glyphs:
             f.write("  { ")
@@ -199,6 +314,10 @@ def main():
         f.write("  // clang-format on\n")
         f.write("};\n\n")
 
+        # Page table
+        write_u16_array(f, f"{var_base}_page_table", page_table)
+        write_u16_array(f, f"{var_base}_pages", [idx for page in pages for idx in page])
+
         # Font instance
         f.write(f"inline constexpr BitmapFont {var_base} = {{\n")
         f.write(f'    "{args.name}", // font name\n')
@@ -207,6 +326,8 @@ def main():
         f.write(f"    -{descent}, // descent (negative)\n")
         f.write(f"    {line_gap}, // lineGap\n")
         f.write(f"    {var_base}_glyphs,\n")
+        f.write(f"    {var_base}_page_table,\n")
+        f.write(f"    {var_base}_pages,\n")
         f.write(f"    {var_base}_bitmap\n")
         f.write("};\n\n")
 
@@ -217,9 +338,9 @@ def main():
 
     if args.preview:
         # Create a preview image
-        # Grid layout: 16 columns (128 chars / 16 = 8 rows)
+        # Grid layout: 16 columns, as many rows as needed
         cols = 16
-        rows = 8
+        rows = (len(glyphs) + cols - 1) // cols
         cell_width = args.size * 2
         cell_height = args.size * 2
         img_width = cols * cell_width
@@ -232,10 +353,9 @@ def main():
         # We put the baseline somewhat below the center to accommodate descenders
         baseline_y = int(cell_height * 0.7)
 
-        for code in range(128):
-            g = glyphs[code]
-            row = code // cols
-            col = code % cols
+        for i, g in enumerate(glyphs):
+            row = i // cols
+            col = i % cols
 
             x_base = col * cell_width + cell_width // 4
             y_base = row * cell_height + baseline_y
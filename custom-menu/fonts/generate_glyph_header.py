@@ -17,7 +17,7 @@ def main():
         overrides_data = yaml.safe_load(f)
 
     for ov in overrides_data.get("overrides", []):
-        overrides_map[ov["target"]] = {
+        overrides_map[ov.get("target", ov["replacement"])] = {
             "name": ov["name"],
         }
 
@@ -26,7 +26,8 @@ def main():
         # Write glyphs sorted by code point
         for code in sorted(overrides_map.keys()):
             ov = overrides_map[code]
-            f.write(f'#define GLYPH_{ov["name"]} "\\x{code:02x}"\n')
+            utf8 = "".join(f"\\x{b:02x}" for b in chr(code).encode("utf-8"))
+            f.write(f'#define GLYPH_{ov["name"]} "{utf8}"\n')
 
     print(f"Wrote {args.out}")
 
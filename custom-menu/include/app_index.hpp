@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#ifndef APP_INDEX_DIR
+#define APP_INDEX_DIR "/online/.custom_menu_index"
+#endif
+
+struct app_manifest {
+  std::string name;
+  bool background = false;
+};
+
+// An app file found in one of the lookup paths
+struct app_index_entry {
+  std::filesystem::path path; // symlinks resolved
+  int64_t mtime = 0;
+  uintmax_t size = 0;
+  std::string extension;
+  std::optional<app_manifest> manifest = std::nullopt;
+};
+
+/**
+ * List the app files in an app lookup path, with their manifests.
+ *
+ * The listing is cached in an index file in APP_INDEX_DIR, which is reused as long as the directory's mtime hasn't
+ * changed. Adding, removing or renaming apps or manifests invalidates it, but editing a manifest in place doesn't.
+ *
+ * @param dir The app lookup path
+ * @param use_index Whether a valid index may be used instead of scanning, the index is updated either way
+ * @return The app files, in no particular order
+ */
+std::vector<app_index_entry> scan_app_directory(const std::filesystem::path &dir, bool use_index = true);
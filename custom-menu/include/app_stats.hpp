@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+#include "apps/app_api.h"
+
+/**
+ * Histogram of call durations in power of two microsecond buckets. Percentiles are rounded up to a bucket's upper
+ * bound, which is plenty to tell a 1 ms callback from a 100 ms one.
+ */
+class latency_histogram {
+  static constexpr uint32_t BUCKETS = 25; // the last one holds everything from ~8 s up
+
+  std::array<uint32_t, BUCKETS> buckets{};
+  uint32_t count = 0;
+  uint32_t max_us = 0;
+  uint64_t total_us = 0;
+
+public:
+  void record(const std::chrono::steady_clock::duration duration) {
+    const auto us = static_cast<uint32_t>(
+      std::clamp<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count(), 0, UINT32_MAX));
+    ++buckets[std::min<uint32_t>(std::bit_width(us), BUCKETS - 1)];
+    ++count;
+    max_us = std::max(max_us, us);
+    total_us += us;
+  }
+
+  /**
+   * @param percentile The percentile to estimate, between 0 and 100
+   * @return The upper bound of the bucket the percentile falls in, capped at the slowest call
+   */
+  [[nodiscard]] uint32_t percentile_us(const double percentile) const {
+    const auto rank = static_cast<uint64_t>(percentile / 100.0 * count + 0.5);
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < BUCKETS; ++i) {
+      seen += buckets[i];
+      if (seen >= std::max<uint64_t>(rank, 1))
+        return i < BUCKETS - 1 ? std::min<uint32_t>((1u << i) - 1, max_us) : max_us;
+    }
+    return max_us;
+  }
+
+  [[nodiscard]] app_call_stats_t summary() const {
+    return { .count = count, .max_us = max_us, .p99_us = percentile_us(99), .total_us = total_us };
+  }
+};
+
+static constexpr const char *APP_CALL_KIND_NAMES[] = {
+  "enter",
+  "leave",
+  "keypress",
+  "timer",
+  "wake_state",
+  "render",
+  "task",
+  "task_done",
+};
+static_assert(std::size(APP_CALL_KIND_NAMES) == APP_CALL_KIND_COUNT);
+
+// Time spent in an app's code, by kind of call
+struct app_stats {
+  std::string_view path; // of the app, never changes once set
+  std::array<latency_histogram, APP_CALL_KIND_COUNT> calls{};
+  uint32_t budget_strikes = 0; // callbacks over budget since the app was loaded
+};
@@ -1,9 +1,17 @@
 #pragma once
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <list>
+#include <optional>
+#include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include "clay.hpp"
@@ -35,6 +43,44 @@ struct Glyph {
   std::uint32_t bitmapOffset; // offset into Font::bitmap (bytes)
 };
 
+// Decode the UTF-8 sequence starting at text[pos] and advance pos past it. Malformed input (stray continuation bytes,
+// truncated or overlong sequences, surrogates) decodes to U+FFFD and consumes a single byte so decoding resyncs.
+constexpr std::uint32_t utf8_next(const std::string_view text, std::size_t &pos) noexcept {
+  constexpr std::uint32_t REPLACEMENT = 0xFFFD;
+  constexpr std::uint32_t MIN_CODEPOINT[] = { 0, 0, 0x80, 0x800, 0x10000 };
+
+  const std::size_t start = pos;
+  const auto lead = static_cast<std::uint8_t>(text[pos++]);
+  if (lead < 0x80)
+    return lead;
+
+  const int len = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 0;
+  if (len == 0 || lead > 0xF4 || start + len > text.size())
+    return REPLACEMENT;
+
+  std::uint32_t cp = lead & (0x7Fu >> len);
+  for (int i = 1; i < len; ++i) {
+    const auto cont = static_cast<std::uint8_t>(text[start + i]);
+    if ((cont & 0xC0) != 0x80)
+      return REPLACEMENT;
+    cp = (cp << 6) | (cont & 0x3Fu);
+  }
+  if (cp < MIN_CODEPOINT[len] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+    return REPLACEMENT;
+
+  pos = start + len;
+  return cp;
+}
+
+// FNV-1a over a font id and the string bytes, used to key the text caches
+constexpr std::uint64_t hash_text(const std::uint16_t fontId, const std::string_view text) noexcept {
+  std::uint64_t h = 0xcbf29ce484222325ull;
+  h = (h ^ fontId) * 0x100000001b3ull;
+  for (const char ch : text)
+    h = (h ^ static_cast<std::uint8_t>(ch)) * 0x100000001b3ull;
+  return h;
+}
+
 struct BitmapFont {
   const char *name;
 
@@ -43,12 +89,15 @@ struct BitmapFont {
   std::int16_t descent; // negative
   std::int16_t lineGap;
 
-  const Glyph *glyphs; // 128 entries, ASCII 0–127
+  const Glyph *glyphs; // sparse glyph set, sorted by codepoint
+  const std::uint16_t *pageTable; // 256 entries, one per 256-codepoint page of the BMP, indexing into pages
+  const std::uint16_t *pages; // 256 glyph indices per page; page 0 maps every codepoint to the fallback glyph
   const std::uint8_t *bitmap; // 8bpp alpha
 
-  [[nodiscard]] const Glyph &glyph(const std::uint32_t codepoint) const noexcept {
-    const std::uint32_t idx = (codepoint < 128) ? codepoint : static_cast<std::uint32_t>('?');
-    return glyphs[idx];
+  [[nodiscard]] constexpr const Glyph &glyph(const std::uint32_t codepoint) const noexcept {
+    // Codepoints outside the BMP go through the empty page 0 and resolve to the fallback glyph
+    const std::uint32_t page = codepoint <= 0xFFFF ? pageTable[codepoint >> 8] : 0;
+    return glyphs[pages[(page << 8) | (codepoint & 0xFF)]];
   }
 
   struct TextMetrics {
@@ -56,21 +105,22 @@ struct BitmapFont {
     std::int32_t height;
   };
 
-  [[nodiscard]] TextMetrics measure(const std::string_view text) const noexcept {
+  [[nodiscard]] constexpr TextMetrics measure(const std::string_view text) const noexcept {
     std::int32_t lineWidth = 0;
     std::int32_t maxWidth = 0;
     std::int32_t lines = 1;
 
     const std::int32_t lineHeight = ascent - descent;
 
-    for (const char ch : text) {
-      if (ch == '\n') {
+    for (std::size_t pos = 0; pos < text.size();) {
+      const std::uint32_t cp = utf8_next(text, pos);
+      if (cp == '\n') {
         maxWidth = std::max(maxWidth, lineWidth);
         lineWidth = 0;
         ++lines;
         continue;
       }
-      const Glyph &g = glyph(static_cast<std::uint8_t>(ch));
+      const Glyph &g = glyph(cp);
       lineWidth += g.advance;
     }
 
@@ -90,6 +140,8 @@ struct IntRect {
   int y;
   int w;
   int h;
+
+  bool operator==(const IntRect &) const = default;
 };
 
 constexpr IntRect bbox_to_int(const Clay_BoundingBox &bb) {
@@ -134,6 +186,676 @@ constexpr std::uint16_t pack_bgr565(const Clay_Color &color) {
   return static_cast<std::uint16_t>((r5 << 11) | (g6 << 5) | (b5));
 }
 
+// ------------------------------------------------------------
+// Text measurement cache
+// ------------------------------------------------------------
+
+// Fixed-capacity, direct-mapped cache of text measurements keyed on (font id, string hash, length). A colliding entry
+// simply replaces the previous one.
+class TextMeasureCache {
+public:
+  static constexpr std::size_t CAPACITY = 256;
+
+  struct Stats {
+    std::uint32_t hits;
+    std::uint32_t misses;
+  };
+
+private:
+  struct Entry {
+    std::uint64_t hash;
+    std::uint32_t length;
+    std::uint16_t fontId;
+    bool valid;
+    BitmapFont::TextMetrics metrics;
+  };
+
+  std::array<Entry, CAPACITY> entries{};
+  std::uint32_t hits = 0;
+  std::uint32_t misses = 0;
+
+public:
+  /**
+   * Measure text with the given font, returning the memoized result if available.
+   */
+  BitmapFont::TextMetrics measure(const BitmapFont &font, const std::uint16_t fontId, const std::string_view text) {
+    const std::uint64_t h = hash_text(fontId, text);
+    Entry &e = entries[h % CAPACITY];
+    if (e.valid && e.hash == h && e.length == text.size() && e.fontId == fontId) {
+      ++hits;
+      return e.metrics;
+    }
+    ++misses;
+    e = Entry{ h, static_cast<std::uint32_t>(text.size()), fontId, true, font.measure(text) };
+    return e.metrics;
+  }
+
+  /**
+   * Drop all memoized measurements, i.e. because the font registry changed.
+   */
+  void invalidate() { entries.fill(Entry{}); }
+
+  [[nodiscard]] Stats stats() const noexcept { return Stats{ hits, misses }; }
+};
+
+// ------------------------------------------------------------
+// Text run cache
+// ------------------------------------------------------------
+
+// LRU cache of rasterized text runs, bounded by a byte budget. Runs are stored as 8bpp coverage rather than final
+// colors, so one entry serves every color the same string is drawn in and the key is just (font, string).
+class TextRunCache {
+public:
+  static constexpr std::size_t DEFAULT_BUDGET_BYTES = 32 * 1024;
+
+  struct Run {
+    int offsetX = 0; // top-left of the coverage bitmap, relative to the text bounding box
+    int offsetY = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<std::uint8_t> coverage; // width * height, row-major
+    std::vector<std::pair<std::uint16_t, std::uint16_t>> rowSpans; // per row: [first, last) non-zero column
+
+    [[nodiscard]] std::size_t byteSize() const {
+      return coverage.size() + rowSpans.size() * sizeof(rowSpans[0]) + sizeof(Run);
+    }
+  };
+
+  struct Stats {
+    std::uint32_t hits;
+    std::uint32_t misses;
+    std::uint32_t evictions;
+    std::size_t bytes;
+    std::size_t entries;
+  };
+
+private:
+  struct Entry {
+    std::uint64_t hash;
+    std::uint16_t fontId;
+    std::string text;
+    Run run;
+    std::size_t bytes;
+  };
+
+  std::size_t budget;
+  std::size_t used = 0;
+  std::list<Entry> lru; // most recently used first
+  std::unordered_map<std::uint64_t, std::list<Entry>::iterator> index;
+  std::uint32_t hits = 0;
+  std::uint32_t misses = 0;
+  std::uint32_t evictions = 0;
+
+  void erase(const std::list<Entry>::iterator it) {
+    used -= it->bytes;
+    index.erase(it->hash);
+    lru.erase(it);
+  }
+
+public:
+  explicit TextRunCache(const std::size_t budgetBytes = DEFAULT_BUDGET_BYTES) : budget(budgetBytes) {}
+
+  TextRunCache(const TextRunCache &) = delete;
+  TextRunCache &operator=(const TextRunCache &) = delete;
+
+  /**
+   * Look up a rasterized run, marking it as most recently used.
+   *
+   * @return The cached run, or nullptr on a miss
+   */
+  const Run *find(const std::uint16_t fontId, const std::string_view text) {
+    const std::uint64_t h = hash_text(fontId, text);
+    const auto it = index.find(h);
+    if (it == index.end() || it->second->fontId != fontId || it->second->text != text) {
+      ++misses;
+      return nullptr;
+    }
+    ++hits;
+    lru.splice(lru.begin(), lru, it->second);
+    return &it->second->run;
+  }
+
+  /**
+   * Store a rasterized run, evicting least recently used runs to stay within the budget. Runs larger than a quarter
+   * of the budget are not cached, so a single long label can't flush everything else.
+   *
+   * @return The cached run, or nullptr if it was not cached
+   */
+  const Run *insert(const std::uint16_t fontId, const std::string_view text, Run &&run) {
+    const std::size_t bytes = run.byteSize() + text.size() + sizeof(Entry);
+    if (bytes > budget / 4)
+      return nullptr;
+
+    const std::uint64_t h = hash_text(fontId, text);
+    if (const auto it = index.find(h); it != index.end())
+      erase(it->second);
+    while (used + bytes > budget && !lru.empty()) {
+      erase(std::prev(lru.end()));
+      ++evictions;
+    }
+
+    lru.push_front(Entry{ h, fontId, std::string(text), std::move(run), bytes });
+    index[h] = lru.begin();
+    used += bytes;
+    return &lru.front().run;
+  }
+
+  void clear() {
+    lru.clear();
+    index.clear();
+    used = 0;
+  }
+
+  void setBudget(const std::size_t budgetBytes) {
+    budget = budgetBytes;
+    while (used > budget && !lru.empty()) {
+      erase(std::prev(lru.end()));
+      ++evictions;
+    }
+  }
+
+  [[nodiscard]] std::size_t getBudget() const noexcept { return budget; }
+
+  [[nodiscard]] Stats stats() const noexcept { return Stats{ hits, misses, evictions, used, lru.size() }; }
+
+  /**
+   * Rasterize a text run into coverage, with the same layout rules as the direct glyph path: baseline at the font
+   * ascent, newlines restart at the left edge one line height down. Overlapping glyphs combine with max().
+   */
+  static Run rasterize(const BitmapFont &font, const std::string_view text) {
+    const int lineHeight = font.ascent - font.descent + font.lineGap;
+
+    // First pass: bounds of all glyph bitmaps relative to the text origin
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+    bool empty = true;
+    int cursorX = 0;
+    int cursorY = font.ascent;
+    for (std::size_t pos = 0; pos < text.size();) {
+      const std::uint32_t cp = utf8_next(text, pos);
+      if (cp == '\n') {
+        cursorX = 0;
+        cursorY += lineHeight;
+        continue;
+      }
+      const Glyph &g = font.glyph(cp);
+      if (g.width > 0 && g.height > 0) {
+        const int gx = cursorX + g.bearingX;
+        const int gy = cursorY - g.bearingY;
+        if (empty) {
+          x0 = gx, y0 = gy, x1 = gx + g.width, y1 = gy + g.height;
+          empty = false;
+        } else {
+          x0 = std::min(x0, gx), y0 = std::min(y0, gy);
+          x1 = std::max(x1, gx + g.width), y1 = std::max(y1, gy + g.height);
+        }
+      }
+      cursorX += g.advance;
+    }
+
+    Run run;
+    if (empty)
+      return run;
+    run.offsetX = x0;
+    run.offsetY = y0;
+    run.width = x1 - x0;
+    run.height = y1 - y0;
+    run.coverage.assign(static_cast<std::size_t>(run.width) * static_cast<std::size_t>(run.height), 0);
+
+    // Second pass: composite glyph coverage
+    cursorX = 0;
+    cursorY = font.ascent;
+    for (std::size_t pos = 0; pos < text.size();) {
+      const std::uint32_t cp = utf8_next(text, pos);
+      if (cp == '\n') {
+        cursorX = 0;
+        cursorY += lineHeight;
+        continue;
+      }
+      const Glyph &g = font.glyph(cp);
+      const std::uint8_t *bmp = font.bitmap + g.bitmapOffset;
+      const int gx = cursorX + g.bearingX - x0;
+      const int gy = cursorY - g.bearingY - y0;
+      for (int yy = 0; yy < g.height; ++yy) {
+        std::uint8_t *dst = run.coverage.data() + static_cast<std::size_t>(gy + yy) * run.width + gx;
+        const std::uint8_t *src = bmp + static_cast<std::size_t>(yy) * g.width;
+        for (int xx = 0; xx < g.width; ++xx)
+          dst[xx] = std::max(dst[xx], src[xx]);
+      }
+      cursorX += g.advance;
+    }
+
+    run.rowSpans.resize(static_cast<std::size_t>(run.height));
+    for (int yy = 0; yy < run.height; ++yy) {
+      const std::uint8_t *row = run.coverage.data() + static_cast<std::size_t>(yy) * run.width;
+      int first = 0;
+      while (first < run.width && row[first] == 0)
+        ++first;
+      int last = run.width;
+      while (last > first && row[last - 1] == 0)
+        --last;
+      run.rowSpans[yy] = { static_cast<std::uint16_t>(first), static_cast<std::uint16_t>(last) };
+    }
+    return run;
+  }
+};
+
+// ------------------------------------------------------------
+// Render command hashing
+// ------------------------------------------------------------
+
+constexpr std::uint64_t fnv1a_mix(std::uint64_t h, const std::uint64_t v) noexcept {
+  for (int shift = 0; shift < 64; shift += 8)
+    h = (h ^ ((v >> shift) & 0xFF)) * 0x100000001b3ull;
+  return h;
+}
+
+// FNV-1a over everything that affects the rasterized output of a render command: its type, bounding box, colors,
+// border widths, corner radii, text contents and font settings. Images are hashed by descriptor pointer, so they're
+// assumed to be immutable.
+inline std::uint64_t hash_render_command(std::uint64_t h, const Clay_RenderCommand &cmd) noexcept {
+  auto mix = [&h](const std::uint64_t v) { h = fnv1a_mix(h, v); };
+  auto mixFloat = [&mix](const float v) { mix(std::bit_cast<std::uint32_t>(v)); };
+  auto mixColor = [&mixFloat](const Clay_Color &c) {
+    mixFloat(c.r);
+    mixFloat(c.g);
+    mixFloat(c.b);
+    mixFloat(c.a);
+  };
+  auto mixCorners = [&mixFloat](const Clay_CornerRadius &r) {
+    mixFloat(r.topLeft);
+    mixFloat(r.topRight);
+    mixFloat(r.bottomLeft);
+    mixFloat(r.bottomRight);
+  };
+
+  mix(cmd.commandType);
+  mixFloat(cmd.boundingBox.x);
+  mixFloat(cmd.boundingBox.y);
+  mixFloat(cmd.boundingBox.width);
+  mixFloat(cmd.boundingBox.height);
+
+  switch (cmd.commandType) {
+  case CLAY_RENDER_COMMAND_TYPE_RECTANGLE:
+    mixColor(cmd.renderData.rectangle.backgroundColor);
+    mixCorners(cmd.renderData.rectangle.cornerRadius);
+    break;
+  case CLAY_RENDER_COMMAND_TYPE_BORDER: {
+    const Clay_BorderRenderData &b = cmd.renderData.border;
+    mixColor(b.color);
+    mixCorners(b.cornerRadius);
+    mix(b.width.left | static_cast<std::uint64_t>(b.width.right) << 16 |
+        static_cast<std::uint64_t>(b.width.top) << 32 | static_cast<std::uint64_t>(b.width.bottom) << 48);
+    mix(b.width.betweenChildren);
+    break;
+  }
+  case CLAY_RENDER_COMMAND_TYPE_TEXT: {
+    const Clay_TextRenderData &t = cmd.renderData.text;
+    mix(hash_text(t.fontId, { t.stringContents.chars, static_cast<std::size_t>(t.stringContents.length) }));
+    mixColor(t.textColor);
+    mix(t.fontSize | static_cast<std::uint64_t>(t.letterSpacing) << 16 |
+        static_cast<std::uint64_t>(t.lineHeight) << 32);
+    break;
+  }
+  case CLAY_RENDER_COMMAND_TYPE_IMAGE:
+    mix(reinterpret_cast<std::uintptr_t>(cmd.renderData.image.imageData));
+    mixColor(cmd.renderData.image.backgroundColor);
+    break;
+  default:
+    break;
+  }
+  return h;
+}
+
+inline std::uint64_t hash_render_commands(const Clay_RenderCommandArray &cmdArray) noexcept {
+  std::uint64_t h = 0xcbf29ce484222325ull;
+  h = fnv1a_mix(h, static_cast<std::uint32_t>(cmdArray.length));
+  for (int32_t i = 0; i < cmdArray.length; ++i)
+    h = hash_render_command(h, cmdArray.internalArray[i]);
+  return h;
+}
+
+// ------------------------------------------------------------
+// Damage tracking
+// ------------------------------------------------------------
+
+// Screen area covered by a text command's glyphs, which may extend past its bounding box by the glyph bearings
+inline IntRect text_ink_bounds(const IntRect &bb, const BitmapFont &font, const std::string_view text) noexcept {
+  const int lineHeight = font.ascent - font.descent + font.lineGap;
+  int x0 = bb.x, y0 = bb.y, x1 = bb.x + bb.w, y1 = bb.y + bb.h;
+  int cursorX = bb.x;
+  int baseline = bb.y + font.ascent;
+  for (std::size_t pos = 0; pos < text.size();) {
+    const std::uint32_t cp = utf8_next(text, pos);
+    if (cp == '\n') {
+      cursorX = bb.x;
+      baseline += lineHeight;
+      continue;
+    }
+    const Glyph &g = font.glyph(cp);
+    if (g.width > 0 && g.height > 0) {
+      x0 = std::min(x0, cursorX + g.bearingX);
+      y0 = std::min(y0, baseline - g.bearingY);
+      x1 = std::max(x1, cursorX + g.bearingX + g.width);
+      y1 = std::max(y1, baseline - g.bearingY + g.height);
+    }
+    cursorX += g.advance;
+  }
+  return { x0, y0, x1 - x0, y1 - y0 };
+}
+
+// Bounding box of two rectangles
+constexpr IntRect bounding_union(const IntRect &a, const IntRect &b) {
+  const int x0 = std::min(a.x, b.x);
+  const int y0 = std::min(a.y, b.y);
+  const int x1 = std::max(a.x + a.w, b.x + b.w);
+  const int y1 = std::max(a.y + a.h, b.y + b.h);
+  return { x0, y0, x1 - x0, y1 - y0 };
+}
+
+// Changes needed to turn the previous frame into the current one: an optional vertical scroll of a clipped region of
+// the framebuffer, applied first, followed by redrawing the damaged rectangles.
+struct FrameDamage {
+  struct Scroll {
+    IntRect rect;
+    int dy;
+  };
+
+  static constexpr std::size_t MAX_RECTS = 4;
+
+  std::optional<Scroll> scroll;
+  std::vector<IntRect> rects;
+
+  [[nodiscard]] bool empty() const { return !scroll && rects.empty(); }
+
+  /**
+   * Add a damaged rectangle, merging it with the ones it overlaps. When there are too many rectangles, the new one is
+   * merged with whichever grows the least.
+   */
+  void add(IntRect r) {
+    if (r.w <= 0 || r.h <= 0)
+      return;
+    for (std::size_t i = 0; i < rects.size();) {
+      IntRect tmp;
+      if (intersect(rects[i], r, tmp)) {
+        r = bounding_union(rects[i], r);
+        rects.erase(rects.begin() + static_cast<std::ptrdiff_t>(i));
+        i = 0;
+      } else {
+        ++i;
+      }
+    }
+    if (rects.size() < MAX_RECTS) {
+      rects.push_back(r);
+      return;
+    }
+    std::size_t best = 0;
+    int bestGrowth = std::numeric_limits<int>::max();
+    for (std::size_t i = 0; i < rects.size(); ++i) {
+      const IntRect u = bounding_union(rects[i], r);
+      const int growth = u.w * u.h - rects[i].w * rects[i].h;
+      if (growth < bestGrowth) {
+        best = i;
+        bestGrowth = growth;
+      }
+    }
+    const IntRect merged = bounding_union(rects[best], r);
+    rects.erase(rects.begin() + static_cast<std::ptrdiff_t>(best));
+    add(merged);
+  }
+
+  [[nodiscard]] IntRect bounds() const {
+    IntRect b = scroll ? scroll->rect : rects.front();
+    for (const IntRect &r : rects)
+      b = bounding_union(b, r);
+    return b;
+  }
+};
+
+// Finds the part of the screen that changed between two frames. Each drawing command is identified by its element id,
+// its contents, its position and the scissor rectangles it's nested in; commands present in only one of the two frames
+// damage the area they cover.
+//
+// When more of the commands inside a scissor rectangle moved vertically by the same amount than stayed in place, as
+// when a list scrolls, the previous frame's contents of that rectangle are shifted instead, so only the newly exposed
+// strip and whatever actually changed need to be redrawn.
+class DamageTracker {
+  struct Scissor {
+    std::uint32_t id;
+    IntRect raw;
+    IntRect effective;
+    int parent;
+  };
+
+  struct Record {
+    std::uint64_t content; // id, type, contents and everything in the bounding box except its y coordinate
+    int y;
+    int scissor;
+    int order;
+    Clay_RenderCommandType type;
+    IntRect visible;
+    std::uint64_t key;
+
+    bool operator<(const Record &other) const { return key < other.key; }
+  };
+
+  struct Frame {
+    std::vector<Scissor> scissors;
+    std::vector<Record> records;
+    // Command index of each scissor's start, to tell which commands are drawn before it
+    std::vector<int> scissorOrder;
+
+    void clear() {
+      scissors.clear();
+      records.clear();
+      scissorOrder.clear();
+    }
+  };
+
+  Frame previous;
+  Frame current;
+  bool valid = false;
+
+  [[nodiscard]] static bool isInside(const Frame &frame, int scissor, const int ancestor) {
+    for (; scissor >= 0; scissor = frame.scissors[scissor].parent) {
+      if (scissor == ancestor)
+        return true;
+    }
+    return false;
+  }
+
+  // Key of a record, with the record and every scissor nested inside `shifted` moved down by `dy`
+  [[nodiscard]] static std::uint64_t
+  recordKey(const Frame &frame, const Record &record, const int shifted = -1, const int dy = 0) {
+    const bool inside = shifted >= 0 && isInside(frame, record.scissor, shifted);
+    std::uint64_t h = fnv1a_mix(record.content, static_cast<std::uint32_t>(record.y + (inside ? dy : 0)));
+    for (int s = record.scissor; s >= 0; s = frame.scissors[s].parent) {
+      const Scissor &sc = frame.scissors[s];
+      const int sdy = inside && s != shifted && isInside(frame, s, shifted) ? dy : 0;
+      h = fnv1a_mix(h, sc.id);
+      for (const int v : { sc.raw.x, sc.raw.y + sdy, sc.raw.w, sc.raw.h })
+        h = fnv1a_mix(h, static_cast<std::uint32_t>(v));
+    }
+    return h;
+  }
+
+  void buildFrame(const Clay_RenderCommandArray &cmdArray, const font_registry_t &fonts, const IntRect &bounds) {
+    current.clear();
+    int open = -1;
+    for (int32_t i = 0; i < cmdArray.length; ++i) {
+      const Clay_RenderCommand &cmd = cmdArray.internalArray[i];
+      IntRect rect = bbox_to_int(cmd.boundingBox);
+
+      switch (cmd.commandType) {
+      case CLAY_RENDER_COMMAND_TYPE_SCISSOR_START: {
+        IntRect effective;
+        if (!intersect(open >= 0 ? current.scissors[open].effective : bounds, rect, effective))
+          effective = IntRect{ 0, 0, 0, 0 };
+        current.scissors.push_back(Scissor{ cmd.id, rect, effective, open });
+        current.scissorOrder.push_back(i);
+        open = static_cast<int>(current.scissors.size()) - 1;
+        continue;
+      }
+      case CLAY_RENDER_COMMAND_TYPE_SCISSOR_END:
+        if (open >= 0)
+          open = current.scissors[open].parent;
+        continue;
+      case CLAY_RENDER_COMMAND_TYPE_NONE:
+      case CLAY_RENDER_COMMAND_TYPE_CUSTOM:
+        continue;
+      case CLAY_RENDER_COMMAND_TYPE_TEXT: {
+        const auto &t = cmd.renderData.text;
+        if (t.fontId < fonts.size() && fonts[t.fontId]) {
+          const std::string_view text{ t.stringContents.chars, static_cast<std::size_t>(t.stringContents.length) };
+          rect = text_ink_bounds(rect, *fonts[t.fontId], text);
+        }
+        break;
+      }
+      default:
+        break;
+      }
+
+      const IntRect &clip = open >= 0 ? current.scissors[open].effective : bounds;
+      IntRect visible;
+      if (!intersect(rect, clip, visible))
+        continue;
+
+      Clay_RenderCommand unpositioned = cmd;
+      unpositioned.boundingBox.y = 0;
+      Record record{ hash_render_command(fnv1a_mix(0xcbf29ce484222325ull, cmd.id), unpositioned),
+                     static_cast<int>(cmd.boundingBox.y + 0.5f),
+                     open,
+                     i,
+                     cmd.commandType,
+                     visible,
+                     0 };
+      record.key = recordKey(current, record);
+      current.records.push_back(record);
+    }
+  }
+
+  // Find a scissor rectangle, present in both frames, whose contents moved vertically by a common offset
+  [[nodiscard]] std::optional<std::pair<int, int>> detectScroll() const {
+    for (int j = 0; j < static_cast<int>(current.scissors.size()); ++j) {
+      const Scissor &cur = current.scissors[j];
+      if (cur.effective.w <= 0 || cur.effective.h <= 0)
+        continue;
+      int i = 0;
+      for (; i < static_cast<int>(previous.scissors.size()); ++i) {
+        const Scissor &prev = previous.scissors[i];
+        if (prev.id == cur.id && prev.raw == cur.raw && prev.effective == cur.effective)
+          break;
+      }
+      if (i == static_cast<int>(previous.scissors.size()))
+        continue;
+
+      std::unordered_map<std::uint64_t, int> previousY;
+      for (const Record &r : previous.records) {
+        if (isInside(previous, r.scissor, i))
+          previousY.emplace(r.content, r.y);
+      }
+
+      std::unordered_map<int, int> votes;
+      for (const Record &r : current.records) {
+        if (!isInside(current, r.scissor, j))
+          continue;
+        if (const auto it = previousY.find(r.content); it != previousY.end())
+          ++votes[r.y - it->second];
+      }
+
+      // Scrolling pays off if more commands moved by the same offset than stayed in place
+      const auto best = std::max_element(votes.begin(), votes.end(), [](const auto &a, const auto &b) {
+        return a.second < b.second || (a.second == b.second && a.first == 0);
+      });
+      if (best == votes.end() || best->first == 0 || std::abs(best->first) >= cur.effective.h || best->second < 2)
+        continue;
+
+      return std::pair{ i, best->first };
+    }
+    return std::nullopt;
+  }
+
+  // Shifting the framebuffer is only correct if nothing else is drawn inside the region, except solid rectangles
+  // covering all of it underneath the scrolled contents
+  [[nodiscard]] static bool canScroll(const Frame &frame, const int scissor) {
+    const IntRect &region = frame.scissors[scissor].effective;
+    for (const Record &r : frame.records) {
+      if (isInside(frame, r.scissor, scissor))
+        continue;
+      IntRect tmp;
+      if (!intersect(r.visible, region, tmp))
+        continue;
+      const bool covers = r.visible.x <= region.x && r.visible.y <= region.y &&
+                          r.visible.x + r.visible.w >= region.x + region.w &&
+                          r.visible.y + r.visible.h >= region.y + region.h;
+      if (r.type != CLAY_RENDER_COMMAND_TYPE_RECTANGLE || !covers || r.order > frame.scissorOrder[scissor])
+        return false;
+    }
+    return true;
+  }
+
+public:
+  /**
+   * Diff a frame against the previous one and remember it for the next call.
+   *
+   * @param cmdArray The render commands of the new frame
+   * @param fonts The font registry, used to find the extent of text commands
+   * @param bounds The screen bounds
+   * @return The scroll and damaged rectangles turning the previous frame into the new one; the whole screen is damaged
+   *         if there's no valid previous frame, and nothing is if the frame is unchanged
+   */
+  FrameDamage update(const Clay_RenderCommandArray &cmdArray, const font_registry_t &fonts, const IntRect &bounds) {
+    buildFrame(cmdArray, fonts, bounds);
+
+    FrameDamage damage;
+    if (!valid) {
+      damage.add(bounds);
+    } else {
+      if (const auto scroll = detectScroll(); scroll && canScroll(previous, scroll->first)) {
+        const auto [scissor, dy] = *scroll;
+        const IntRect region = previous.scissors[scissor].effective;
+        damage.scroll = FrameDamage::Scroll{ region, dy };
+        damage.add(dy < 0 ? IntRect{ region.x, region.y + region.h + dy, region.w, -dy }
+                          : IntRect{ region.x, region.y, region.w, dy });
+
+        // Move the previous frame's records along with the pixels they drew
+        for (Record &r : previous.records) {
+          if (!isInside(previous, r.scissor, scissor))
+            continue;
+          r.key = recordKey(previous, r, scissor, dy);
+          r.visible.y += dy;
+          if (!intersect(r.visible, region, r.visible))
+            r.visible = IntRect{ 0, 0, 0, 0 };
+        }
+      }
+
+      // Both lists are sorted by key: walk them together and collect the records that only appear in one of them
+      std::sort(previous.records.begin(), previous.records.end());
+      std::sort(current.records.begin(), current.records.end());
+      auto prev = previous.records.begin();
+      auto cur = current.records.begin();
+      while (prev != previous.records.end() || cur != current.records.end()) {
+        if (cur == current.records.end() || (prev != previous.records.end() && prev->key < cur->key)) {
+          damage.add((prev++)->visible);
+        } else if (prev == previous.records.end() || cur->key < prev->key) {
+          damage.add((cur++)->visible);
+        } else {
+          ++prev;
+          ++cur;
+        }
+      }
+    }
+
+    std::swap(previous, current);
+    valid = true;
+    return damage;
+  }
+
+  /**
+   * Forget the previous frame, so that the next update damages the whole screen.
+   */
+  void invalidate() { valid = false; }
+};
+
 // ------------------------------------------------------------
 // CRTP base renderer
 // ------------------------------------------------------------
@@ -143,6 +865,7 @@ class ClayRendererBase {
 protected:
   std::uint16_t *fb;
   const font_registry_t &fonts;
+  TextRunCache *textCache;
 
   Derived &self() noexcept { return static_cast<Derived &>(*this); }
   const Derived &self() const noexcept { return static_cast<const Derived &>(*this); }
@@ -151,7 +874,8 @@ public:
   static constexpr int width = Derived::kWidth;
   static constexpr int height = Derived::kHeight;
 
-  ClayRendererBase(std::uint16_t *fb, const font_registry_t &fonts) noexcept : fb(fb), fonts(fonts) {}
+  ClayRendererBase(std::uint16_t *fb, const font_registry_t &fonts, TextRunCache *textCache = nullptr) noexcept :
+    fb(fb), fonts(fonts), textCache(textCache) {}
 
   [[nodiscard]] const BitmapFont *getFont(const std::uint16_t fontId, std::uint16_t /*size*/) const noexcept {
     if (fontId >= fonts.size()) {
@@ -193,6 +917,8 @@ public:
     }
   }
 
+  void clearRectBgr565(const IntRect &r, const std::uint16_t colorBgr565) { fillRect(r, nullptr, colorBgr565, false); }
+
 protected:
   void fillRect(const IntRect &r, const IntRect *clip, std::uint16_t colorBgr565, bool monoOn) {
     const IntRect bounds{ 0, 0, Derived::kWidth, Derived::kHeight };
@@ -255,17 +981,28 @@ protected:
       effClip = &bounds;
     }
 
+    if (textCache) {
+      const TextRunCache::Run *run = textCache->find(tdata.fontId, text);
+      if (!run)
+        run = textCache->insert(tdata.fontId, text, TextRunCache::rasterize(font, text));
+      if (run) {
+        blitRun(bb, *effClip, *run, color);
+        return;
+      }
+    }
+
     int cursorX = x;
     int cursorY = y;
 
-    for (const char ch : text) {
-      if (ch == '\n') {
+    for (std::size_t pos = 0; pos < text.size();) {
+      const std::uint32_t cp = utf8_next(text, pos);
+      if (cp == '\n') {
         cursorX = x;
         cursorY += lineHeight;
         continue;
       }
 
-      const Glyph &g = font.glyph(static_cast<std::uint8_t>(ch));
+      const Glyph &g = font.glyph(cp);
 
       const int gx = cursorX + g.bearingX;
       const int gy = cursorY - g.bearingY;
@@ -297,6 +1034,23 @@ protected:
     }
   }
 
+  void blitRun(const IntRect &bb, const IntRect &clip, const TextRunCache::Run &run, const std::uint16_t color) {
+    const int rx = bb.x + run.offsetX;
+    const int ry = bb.y + run.offsetY;
+    const int yStart = std::max(0, clip.y - ry);
+    const int yEnd = std::min(run.height, clip.y + clip.h - ry);
+    for (int yy = yStart; yy < yEnd; ++yy) {
+      const auto [first, last] = run.rowSpans[yy];
+      const int xStart = std::max<int>(first, clip.x - rx);
+      const int xEnd = std::min<int>(last, clip.x + clip.w - rx);
+      const std::uint8_t *row = run.coverage.data() + static_cast<std::size_t>(yy) * run.width;
+      for (int xx = xStart; xx < xEnd; ++xx) {
+        if (row[xx] != 0)
+          self().putPixel(rx + xx, ry + yy, color, row[xx]);
+      }
+    }
+  }
+
   void drawImageInternal(const IntRect &bb, const IntRect *clip, const Clay_ImageRenderData &idata) {
     const auto *img = static_cast<const image_descriptor_t *>(idata.imageData);
     if (!img)
@@ -352,9 +1106,17 @@ protected:
   }
 
 public:
-  void render(const Clay_RenderCommandArray &cmdArray) {
+  /**
+   * Rasterize the render commands, optionally only inside the given clip rectangle.
+   *
+   * @param cmdArray The render commands
+   * @param clip Area to restrict drawing to, or nullptr to draw everywhere
+   */
+  void render(const Clay_RenderCommandArray &cmdArray, const IntRect *clip = nullptr) {
     std::vector<IntRect> scissorStack;
     scissorStack.reserve(8);
+    if (clip)
+      scissorStack.push_back(*clip);
 
     auto currentClip = [&]() -> const IntRect * {
       if (scissorStack.empty())
@@ -482,7 +1244,8 @@ public:
 
   using Base = ClayRendererBase<ClayBGR565Renderer>;
 
-  ClayBGR565Renderer(std::uint16_t *fb, const font_registry_t &fonts) noexcept : Base(fb, fonts) {}
+  ClayBGR565Renderer(std::uint16_t *fb, const font_registry_t &fonts, TextRunCache *textCache = nullptr) noexcept :
+    Base(fb, fonts, textCache) {}
 
   void putPixel(const int x, const int y, const std::uint16_t colorBgr565) const {
     if (x < 0 || y < 0 || x >= kWidth || y >= kHeight)
@@ -537,6 +1300,26 @@ public:
   }
 
   void clear(const Clay_Color &c) { clearBgr565(pack_bgr565(c)); }
+  void clear(const Clay_Color &c, const IntRect &r) { clearRectBgr565(r, pack_bgr565(c)); }
+
+  /**
+   * Move the pixels inside a rectangle vertically by `dy`, leaving the exposed rows untouched.
+   */
+  void scroll(const IntRect &r, const int dy) {
+    IntRect area;
+    if (!intersect(r, IntRect{ 0, 0, kWidth, kHeight }, area) || dy == 0 || std::abs(dy) >= area.h)
+      return;
+    auto moveRow = [&](const int y) {
+      std::copy_n(fb + (y - dy) * kWidth + area.x, area.w, fb + y * kWidth + area.x);
+    };
+    if (dy < 0) {
+      for (int y = area.y; y < area.y + area.h + dy; ++y)
+        moveRow(y);
+    } else {
+      for (int y = area.y + area.h - 1; y >= area.y + dy; --y)
+        moveRow(y);
+    }
+  }
 };
 
 // ------------------------------------------------------------
@@ -550,7 +1333,8 @@ public:
 
   using Base = ClayRendererBase<ClayBW1Renderer>;
 
-  ClayBW1Renderer(std::uint16_t *fb, const font_registry_t &fonts) noexcept : Base(fb, fonts) {}
+  ClayBW1Renderer(std::uint16_t *fb, const font_registry_t &fonts, TextRunCache *textCache = nullptr) noexcept :
+    Base(fb, fonts, textCache) {}
 
   bool getPixel(const int x, const int y) const {
     if (x < 0 || y < 0 || x >= kWidth || y >= kHeight)
@@ -626,4 +1410,25 @@ public:
   }
 
   void clear(const bool on = false) { clearMono(on); }
+  void clear(const bool on, const IntRect &r) { clearRectBgr565(r, on ? 0xFFFF : 0x0000); }
+
+  /**
+   * Move the pixels inside a rectangle vertically by `dy`, leaving the exposed rows untouched.
+   */
+  void scroll(const IntRect &r, const int dy) {
+    IntRect area;
+    if (!intersect(r, IntRect{ 0, 0, kWidth, kHeight }, area) || dy == 0 || std::abs(dy) >= area.h)
+      return;
+    auto moveRow = [&](const int y) {
+      for (int x = area.x; x < area.x + area.w; ++x)
+        putPixel(x, y, getPixel(x, y - dy) ? 0xFFFF : 0x0000);
+    };
+    if (dy < 0) {
+      for (int y = area.y; y < area.y + area.h + dy; ++y)
+        moveRow(y);
+    } else {
+      for (int y = area.y + area.h - 1; y >= area.y + dy; --y)
+        moveRow(y);
+    }
+  }
 };
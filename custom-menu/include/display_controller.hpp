@@ -1,23 +1,69 @@
 #pragma once
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <iostream>
-#include <list>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <queue>
+#include <set>
 #include <span>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
+#include "app_index.hpp"
+#include "app_stats.hpp"
 #include "apps/app_api.hpp"
 #include "clay_fb_renderer.hpp"
 #include "fonts/poppins_12.hpp"
 #include "fonts/poppins_8.hpp"
 #include "hooked_functions.h"
+#include "mpsc_queue.hpp"
+#include "task_pool.hpp"
 #include "timer_helper.hpp"
+#include "timer_queue.hpp"
+
+#ifndef TEXT_RUN_CACHE_BYTES
+#define TEXT_RUN_CACHE_BYTES TextRunCache::DEFAULT_BUDGET_BYTES
+#endif
+
+#ifndef APP_MEMORY_BUDGET_KB
+#define APP_MEMORY_BUDGET_KB 2048
+#endif
+
+#ifndef APP_LOW_MEMORY_KB
+#define APP_LOW_MEMORY_KB 4096
+#endif
+
+#ifndef APP_MEMORY_CHECK_MS
+#define APP_MEMORY_CHECK_MS 30000
+#endif
+
+#ifndef APP_CALLBACK_BUDGET_MS
+#define APP_CALLBACK_BUDGET_MS 200
+#endif
+
+#ifndef APP_CALLBACK_STRIKES
+#define APP_CALLBACK_STRIKES 3
+#endif
+
+#ifndef APP_CALLBACK_HANG_MS
+#define APP_CALLBACK_HANG_MS 5000
+#endif
+
+#ifndef APP_TASK_WORKERS
+#define APP_TASK_WORKERS 2
+#endif
+
+#ifndef APP_TASKS_PER_APP
+#define APP_TASKS_PER_APP 4
+#endif
 
 DECLARE_FN_TYPE(app_register_fn_t, app_descriptor_t *, app_api_t controller_api, void **userptr);
 
@@ -45,6 +91,67 @@ class display_controller : display_controller_api {
                             .buf_len = LCD_WIDTH * LCD_HEIGHT * sizeof(uint16_t),
                             .buf = secret_screen_buf };
   font_registry_t font_registry{ &fonts::Poppins_12, &fonts::Poppins_8 };
+  uint32_t font_generation = 0;
+  TextRunCache text_run_cache{ TEXT_RUN_CACHE_BYTES };
+  TextMeasureCache text_measure_cache;
+
+  // Hash of the last rasterized render command array; identical frames skip rasterization and the panel refresh
+  std::optional<uint64_t> last_frame_hash = std::nullopt;
+  std::atomic<uint32_t> skipped_frames = 0;
+  uint32_t scrolled_frames = 0;
+  // Changed area between frames; only that part of the framebuffer is rasterized and refreshed, and scrolled regions
+  // are shifted in place
+  DamageTracker damage_tracker;
+  uint64_t damaged_pixels = 0;
+  uint64_t rendered_pixels = 0;
+
+#ifdef FRAME_SCHEDULER
+  // Latest frame submitted through clay_render, rasterized at the next frame slot. Text is copied, since apps only keep
+  // it alive for the duration of the call.
+  struct frame_submission {
+    std::vector<Clay_RenderCommand> commands{};
+    std::string text{};
+    uint64_t hash = 0;
+    app_stats *owner = nullptr; // the app that submitted it, rasterizing is accounted to it
+
+    [[nodiscard]] Clay_RenderCommandArray as_array() {
+      const auto length = static_cast<int32_t>(commands.size());
+      return Clay_RenderCommandArray{ length, length, commands.data() };
+    }
+  };
+  frame_submission pending_frame;
+  bool frame_pending = false;
+  uint32_t frame_timer_id = 0;
+  std::chrono::steady_clock::time_point last_frame_slot{};
+  uint32_t coalesced_frames = 0;
+#endif
+
+#ifdef RENDER_THREAD
+  // Rasterization and screen refreshes run on their own thread, which owns the framebuffer, the damage tracker, the
+  // text run cache and the overlay while it runs. Everything else hands it work through render_jobs.
+  using render_job_t = inplace_function<void(), 64>;
+  std::mutex render_mutex;
+  std::condition_variable render_cv;
+  std::deque<render_job_t> render_jobs{};
+  bool render_busy = false;
+  bool render_stop = false;
+  // The frame arena is double-buffered: handoff_frame is swapped with rendering_frame when the render thread picks it
+  // up, so the next frame can be submitted while the previous one is rasterized
+  frame_submission handoff_frame;
+  bool handoff_pending = false;
+  frame_submission rendering_frame;
+  std::thread render_thread;
+#endif
+
+  // Toast banner, rasterized once into its own rows and composited over the app's frame on every refresh
+  struct overlay_state {
+    std::string text;
+    uint32_t first_row = 0;
+    std::vector<uint16_t> pixels{}; // whole framebuffer rows, in the current display format
+    std::vector<uint16_t> backing{}; // the app's pixels under the overlay while it's composited
+  };
+  std::optional<overlay_state> overlay = std::nullopt;
+  uint32_t toast_timer_id = 0;
 
   std::size_t clay_arena_size = Clay_MinMemorySize();
   std::unique_ptr<void, decltype(&std::free)> clay_arena_memory{ std::malloc(clay_arena_size), std::free };
@@ -59,22 +166,131 @@ class display_controller : display_controller_api {
                                    nullptr };
 
   std::vector<std::string> app_lookup_paths = get_app_lookup_paths();
-  std::vector<std::pair<app_descriptor, void *>> apps{};
+  // Apps with a manifest are only listed until they're first entered, see app_index.hpp. They're unloaded again when
+  // they haven't been used in a while and memory runs short.
+  struct app_entry {
+    std::string name;
+    std::string path; // empty for the main menu
+    bool has_ui = true;
+    bool on_demand = false; // listed from its manifest, so it may be unloaded while inactive
+    bool loaded = false;
+    app_descriptor descriptor{}; // all callbacks are null until the app is loaded
+    void *userptr = nullptr;
+    uint32_t last_entered = 0;
+    size_t resident_kb = 0; // how much the resident set grew when the app was loaded
+    // The app file when it was listed, to tell when it's been replaced
+    int64_t mtime = 0;
+    uintmax_t size = 0;
+    app_stats *stats = nullptr; // points into app_call_stats
+  };
+  std::vector<app_entry> apps{};
+  uint32_t app_enter_count = 0;
+  // Repeats unload_idle_apps while inactive on-demand apps are loaded
+  uint32_t memory_check_timer_id = 0;
+  // Handles of the shared object apps, by path
+  std::map<std::string, void *> so_app_handles{};
+  // Time spent in each app's code, by app path. Kept when apps are unloaded, so reloading one doesn't hide its history.
+  std::map<std::string, app_stats> app_call_stats{};
+  // The render thread records rasterization times
+  mutable std::mutex app_stats_mutex;
+  // The app whose code is running on the event loop, timers it schedules are accounted to it
+  app_stats *running_app = nullptr;
+  std::atomic<bool> app_stats_dump_requested = false;
+
+  // Apps whose key presses or timers go over APP_CALLBACK_BUDGET_MS too often are stopped. The watchdog thread looks
+  // for app code that's been running on the event loop for more than APP_CALLBACK_HANG_MS and logs where it's stuck.
+  std::atomic<int64_t> app_call_started = 0; // steady clock ticks, 0 while no app code runs
+  std::atomic<app_stats *> app_call_owner = nullptr;
+  std::atomic<app_call_kind_t> app_call_kind = APP_CALL_ENTER;
+  std::mutex watchdog_mutex;
+  std::condition_variable watchdog_cv;
+  bool watchdog_stop = false;
+  std::thread watchdog_thread;
   std::map<std::string, app_loader_desc_t> app_loaders{};
   std::optional<size_t> active_app_index = std::nullopt;
 
   std::optional<std::string> app_error_message = std::nullopt;
 
+  // Default slack of app timers, so ones due within a few ms of each other share a wakeup
+  static constexpr uint32_t TIMER_SLACK_MS[] = {
+    0, // WAKE_STATE_SLEEP
+    20, // WAKE_STATE_DIMMED
+    5 // WAKE_STATE_FULL
+  };
+
+  // Repeating timers don't fire more often than this
   static constexpr uint32_t FRAME_FPS = 30;
   static constexpr uint32_t FRAME_INTERVAL_MS = 1000 / FRAME_FPS;
 
-  std::recursive_mutex timer_mutex;
-  std::list<timer_helper> active_timers{};
-  uint32_t next_timer_id = 1;
-  std::optional<timer_helper> heartbeat_timer_helper;
-
-  bool is_small_screen_mode = false;
-  bool is_active = false;
+  timer_queue timers;
+  // The heartbeat is a one-shot host timer armed for the next deadline only. Host timers are never deleted, a stale one
+  // just finds nothing due, so the helper they point to must outlive all of them.
+  timer_helper heartbeat_timer_helper{ [this] { on_heartbeat_fired(); }, 0, false };
+  bool heartbeat_enabled = false;
+  bool in_heartbeat = false; // timers scheduled by callbacks are armed for once the heartbeat is done
+  // Deadlines of the host timers that haven't fired yet, earliest first
+  std::vector<std::chrono::steady_clock::time_point> armed_heartbeats{};
+  uint32_t heartbeat_wakeups = 0;
+  // Screen refreshes requested by timers are sent once all timers due in a wakeup have run
+  bool batching_refresh = false;
+  bool refresh_pending = false;
+  std::optional<IntRect> pending_refresh_bounds = std::nullopt;
+  uint32_t coalesced_refreshes = 0;
+
+  // External events are queued by the host's threads and handled one at a time on the event loop thread, so the
+  // controller and the apps only ever run on that thread
+  enum class event_type : uint8_t {
+    keypress,
+    toggle_active,
+    small_screen_detected,
+    unload_idle_apps,
+    apps_changed,
+    stop_app,
+    remove_app,
+    stop
+  };
+  struct event {
+    event_type type;
+    int button = 0;
+    app_stats *app = nullptr;
+  };
+  mpsc_queue<event, 64> events;
+  // Host timer fires are counted rather than queued, so a full queue can't lose one
+  std::atomic<uint32_t> heartbeat_fires = 0;
+  // Bumped after every post, the event loop sleeps on it
+  std::atomic<uint32_t> event_signal = 0;
+  std::thread event_thread;
+
+  // Background tasks posted by the apps, owned by their app_stats. Their completions run on the event loop.
+  static constexpr uint32_t TASK_QUEUE_CAPACITY = 32;
+  std::atomic<bool> task_completions_pending = false;
+  task_pool tasks{ APP_TASK_WORKERS, TASK_QUEUE_CAPACITY, APP_TASKS_PER_APP, [this] {
+                    task_completions_pending.store(true, std::memory_order_relaxed);
+                    wake_event_loop();
+                  } };
+
+#ifdef APP_HOT_RELOAD
+  // Watches the app lookup paths and posts apps_changed once they settle after a change
+  static constexpr int APP_RELOAD_SETTLE_MS = 250;
+  int app_watch_fd = -1;
+  int app_watch_stop_fd = -1;
+  std::thread app_watch_thread;
+  // Lookup paths by watch descriptor, and the parents of the ones that don't exist yet so they're watched once created.
+  // Only used by the watcher thread once it's started.
+  std::map<int, std::string> app_watch_dirs{};
+  std::map<int, std::string> app_watch_parents{};
+  // Lookup paths with apps or manifests changed since the last reload
+  std::mutex app_reload_mutex;
+  std::set<std::string> app_reload_paths{};
+#endif
+
+  // Also read by the host's threads
+  std::atomic<bool> is_small_screen_mode = false;
+  std::atomic<bool> is_active = false;
+  // Whether the host should treat the custom menu as active. Toggles flip it on the host's thread before they're
+  // queued, so the stock UI stops drawing and getting key presses right away rather than once the event loop gets to
+  // them.
+  std::atomic<bool> host_active = false;
 
   wake_state_t current_wake_state = WAKE_STATE_FULL;
   std::chrono::steady_clock::time_point next_wake_state_due{};
@@ -84,18 +300,168 @@ class display_controller : display_controller_api {
 
   void load_apps();
 
+  // Lookup paths in changed_paths are scanned again, the others may be read from their index
+  std::vector<app_index_entry> scan_app_lookup_paths(const std::set<std::string> &changed_paths);
+
+  // Lists or loads a newly found app file, depending on its manifest
+  void add_app(const app_index_entry &file);
+
+  bool load_app(app_entry &app);
+
+  // Tears down a loaded app and closes its shared object
+  void release_app(app_entry &app);
+
+  void unload_app(app_entry &app);
+
+  // Brings the apps in line with the lookup paths after some of them changed. Apps that were removed or replaced are
+  // torn down, new or replaced ones are added again, and the main menu is rebuilt if it's showing.
+  void reload_apps(const std::set<std::string> &changed_paths);
+
+#ifdef APP_HOT_RELOAD
+  void watch_app_directories();
+
+  // Watches a lookup path, or its parent until it's created. Returns whether the lookup path itself is watched.
+  bool watch_app_directory(const std::string &path);
+
+  void app_watch_loop();
+
+  void stop_watching_app_directories();
+#endif
+
+  // Unloads inactive on-demand apps, least recently used first, while they take up more than the budget or the system
+  // is low on memory. Runs on app switches, and every APP_MEMORY_CHECK_MS while any are left loaded. Only call from the
+  // event loop, never from inside an app's callback.
+  void unload_idle_apps();
+
   void set_active_app(std::optional<size_t> app_index);
 
   void on_heartbeat_timer();
 
+  // Runs on the host's timer thread
+  void on_heartbeat_fired() {
+    heartbeat_fires.fetch_add(1, std::memory_order_relaxed);
+    wake_event_loop();
+  }
+
+  void post_event(const event &ev);
+
+  void wake_event_loop();
+
+  void event_loop();
+
+  void handle_event(const event &ev);
+
+  void record_app_call(app_stats *stats, app_call_kind_t kind, std::chrono::steady_clock::duration duration);
+
+  app_stats *get_app_stats(const std::string &app_path);
+
+  // Returns the app that was running before
+  app_stats *begin_app_call(app_stats *stats, app_call_kind_t kind);
+
+  void end_app_call(app_stats *outer, app_call_kind_t kind, std::chrono::steady_clock::time_point start);
+
+  /**
+   * Call into an app's code, accounting the time it takes to the app.
+   *
+   * @param stats The app's stats
+   * @param kind The kind of call
+   * @param fn The call
+   * @return What fn returned
+   */
+  template<typename F>
+  decltype(auto) call_app(app_stats *stats, const app_call_kind_t kind, F &&fn) {
+    struct scope {
+      display_controller &controller;
+      app_stats *outer;
+      app_call_kind_t kind;
+      std::chrono::steady_clock::time_point start;
+
+      ~scope() { controller.end_app_call(outer, kind, start); }
+    } const guard{ *this, begin_app_call(stats, kind), kind, std::chrono::steady_clock::now() };
+    return std::forward<F>(fn)();
+  }
+
+  // Stops an app that went over its callback budget too many times
+  void stop_app(app_stats *stats);
+
+  // Unloads an app that reported a fatal error and drops it from the menu
+  void remove_app(app_stats *stats);
+
+  void run_task_completions();
+
+  // Cancels an app's background tasks and waits for the running ones, before its code goes away
+  void cancel_app_tasks(const app_entry &app);
+
+  void watchdog_loop();
+
+  void dump_app_stats() const;
+
   void send_msg(const uint32_t msg_type) const;
 
   void bump_wake_state();
 
-  static void cancel_heartbeat_timer_callback(void *userptr);
-
   void manage_heartbeat_timer(bool enable);
 
+  [[nodiscard]] std::optional<std::chrono::steady_clock::time_point> next_heartbeat_deadline() const;
+
+  void arm_heartbeat_timer();
+
+  [[nodiscard]] size_t row_words() const { return is_small_screen_mode ? width() / 16 : width(); }
+
+  void rasterize_overlay();
+
+  /**
+   * Rasterize the damaged part of a frame into the framebuffer.
+   *
+   * @param cmds The render commands of the frame
+   * @return The part of the screen that changed, or nothing if the frame has no damage
+   */
+  std::optional<IntRect> rasterize_frame(const Clay_RenderCommandArray &cmds);
+
+  /**
+   * Run a job that touches the framebuffer or the screen. With the render thread, the job is queued to run there in
+   * order, otherwise it runs right away.
+   */
+  template<typename F>
+  void on_render_thread(F &&job) {
+#ifdef RENDER_THREAD
+    {
+      std::scoped_lock lock(render_mutex);
+      render_jobs.emplace_back(std::forward<F>(job));
+    }
+    render_cv.notify_all();
+#else
+    job();
+#endif
+  }
+
+  /**
+   * Wait for the render thread to finish all queued jobs, i.e. before changing state it reads.
+   */
+  void flush_render_thread();
+
+#ifdef RENDER_THREAD
+  void render_thread_loop();
+
+  void render_handoff_frame();
+#endif
+
+#ifdef FRAME_SCHEDULER
+  void submit_frame(const Clay_RenderCommandArray &cmds, uint64_t frame_hash);
+
+  void on_frame_slot();
+
+  void drop_pending_frame();
+#endif
+
+  /**
+   * Send the framebuffer to the screen, with the overlay composited on top if there is one. The framebuffer is left
+   * holding the app's frame only.
+   *
+   * @param bounds The part of the screen that changed, or nothing if unknown
+   */
+  void present(std::optional<IntRect> bounds = std::nullopt);
+
 public:
   display_controller();
   ~display_controller();
@@ -112,31 +478,116 @@ public:
   // NOLINTNEXTLINE(*-convert-member-functions-to-static)
   [[nodiscard]] uint8_t width() const { return LCD_WIDTH; }
   [[nodiscard]] uint8_t height() const { return is_small_screen_mode ? LCD_HEIGHT / 2 : LCD_HEIGHT; }
-  [[nodiscard]] bool active() const { return is_active; }
+  [[nodiscard]] bool active() const { return host_active; }
   [[nodiscard]] bool is_own_screen(const lcd_screen *screen) const { return screen == &secret_screen; }
   [[nodiscard]] bool is_small_screen() const { return is_small_screen_mode; }
   [[nodiscard]] const font_registry_t &get_font_registry() const { return font_registry; }
+  [[nodiscard]] uint32_t get_font_generation() const { return font_generation; }
+  [[nodiscard]] const TextRunCache &get_text_run_cache() const { return text_run_cache; }
+  [[nodiscard]] const TextMeasureCache &get_text_measure_cache() const { return text_measure_cache; }
+  [[nodiscard]] uint32_t get_skipped_frames() const { return skipped_frames.load(); }
+#ifdef FRAME_SCHEDULER
+  [[nodiscard]] uint32_t get_coalesced_frames() const { return coalesced_frames; }
+#endif
+
+  /**
+   * Forget the last rendered frame, so that the next clay_render call redraws the screen even if its render commands
+   * are unchanged. Needed whenever the framebuffer or the panel contents change behind the renderer's back.
+   */
+  void invalidate_frame() {
+    last_frame_hash.reset();
+    on_render_thread([this] { damage_tracker.invalidate(); });
+  }
+
+  /**
+   * Add a font to the registry, invalidating any cached text measurements and rasterized text runs, and bumping the
+   * font generation so that interned font handles are resolved again.
+   *
+   * @return The ID of the new font
+   */
+  uint16_t add_font(const BitmapFont *font);
+
+  BitmapFont::TextMetrics measure_text(uint16_t font_id, std::string_view text);
 
   Clay_Dimensions clay_measure_text(const Clay_StringSlice &text, Clay_TextElementConfig *config);
 
+  /**
+   * Rasterize a frame and send it to the screen. With the frame scheduler, the frame is only copied, and the latest one
+   * submitted is rasterized at the next frame slot.
+   *
+   * @param cmds The render commands of the frame
+   */
   void clay_render(const Clay_RenderCommandArray &cmds);
 
   void draw_frame(const std::span<const uint16_t> &buf) {
+#ifdef FRAME_SCHEDULER
+    // The latest frame wins, even if it's a raw one
+    drop_pending_frame();
+#endif
+    invalidate_frame();
+#ifdef RENDER_THREAD
+    on_render_thread([this, frame = std::vector(buf.begin(), buf.end())] {
+      std::ranges::copy(frame, secret_screen_buf);
+      present();
+    });
+#else
     std::copy(buf.begin(), buf.end(), secret_screen_buf);
-    lcd_refresh_screen(&secret_screen);
+    present();
+#endif
   }
 
   void draw_frame(const std::span<uint16_t> &buf) {
     return draw_frame(static_cast<const std::span<const uint16_t>>(buf));
   }
 
-  [[nodiscard]] std::optional<uint16_t> get_font(const std::string &fontName, int fontSize) const;
+  [[nodiscard]] std::optional<uint16_t> get_font(std::string_view fontName, int fontSize) const;
 
   void set_active(bool active);
 
   void switch_to_small_screen_mode();
 
-  void refresh_screen() const { lcd_refresh_screen(&secret_screen); }
+  /**
+   * Toggle the custom menu. active() changes right away, the menu itself is shown or hidden on the event loop. Safe to
+   * call from any thread.
+   */
+  void post_toggle_active() {
+    bool active = host_active.load();
+    while (!host_active.compare_exchange_weak(active, !active)) {
+    }
+    post_event({ .type = event_type::toggle_active });
+  }
+
+  /**
+   * Queue a key press, to be handled on the event loop. Safe to call from any thread.
+   *
+   * @param button The button that was pressed
+   */
+  void post_keypress(const int button) { post_event({ .type = event_type::keypress, .button = button }); }
+
+  /**
+   * Queue a switch to the small screen mode, to be handled on the event loop. Safe to call from any thread.
+   */
+  void post_small_screen_detected() { post_event({ .type = event_type::small_screen_detected }); }
+
+  /**
+   * Have the event loop print every app's call stats. Only touches atomics, so it's safe to call from a signal handler.
+   */
+  void request_app_stats_dump() {
+    app_stats_dump_requested.store(true, std::memory_order_relaxed);
+    wake_event_loop();
+  }
+
+  void refresh_screen() { on_render_thread([this] { present(); }); }
+
+  /**
+   * Show a toast banner at the bottom of the screen, replacing the current one. The app isn't asked to render again.
+   *
+   * @param text The text to show
+   * @param duration_ms How long to show the toast for, or 0 to keep it until hide_toast is called
+   */
+  void show_toast(const std::string &text, uint32_t duration_ms);
+
+  void hide_toast();
 
   void on_keypress(int button);
 
@@ -149,12 +600,43 @@ public:
 
   void fatal_error(const char *message, bool unload_app);
 
-  uint32_t schedule_timer(std::function<void()> &&callback, uint32_t interval_ms, bool repeat = false);
-
-  uint32_t
-  schedule_timer(void (*callback)(void *userptr), uint32_t interval_ms, bool repeat = false, void *userptr = nullptr);
+  /**
+   * @param slack_ms How late the timer may run, or nothing to use the default for the wake state
+   * @param owner The app the callback's time is accounted to, or null for the controller's own timers
+   */
+  uint32_t schedule_timer(timer_queue::callback_t &&callback,
+                          uint32_t interval_ms,
+                          bool repeat = false,
+                          std::optional<uint32_t> slack_ms = std::nullopt,
+                          app_stats *owner = nullptr);
+
+  uint32_t schedule_timer(void (*callback)(void *userptr),
+                          uint32_t interval_ms,
+                          bool repeat = false,
+                          void *userptr = nullptr,
+                          std::optional<uint32_t> slack_ms = std::nullopt,
+                          app_stats *owner = nullptr);
 
   uint32_t cancel_timer(uint32_t timer_id);
 
-  const std::vector<std::pair<app_descriptor, void *>> &get_apps() { return apps; }
+  /**
+   * Run a task on a worker thread, on behalf of the app whose code is running.
+   *
+   * @param task Run on a worker thread
+   * @param done Run on the event loop once the task returned or was canceled
+   * @return The task ID, or 0 if it couldn't be queued
+   */
+  uint32_t post_background_task(task_pool::task_t &&task, task_pool::done_t &&done);
+
+  uint32_t cancel_background_task(uint32_t task_id);
+
+  const std::vector<app_entry> &get_apps() { return apps; }
+
+  [[nodiscard]] app_stats *get_running_app() const { return running_app; }
+
+  [[nodiscard]] size_t get_app_count() const { return apps.size(); }
+
+  [[nodiscard]] const char *get_app_name(size_t app_index) const;
+
+  [[nodiscard]] std::optional<app_call_stats_t> get_app_call_stats(size_t app_index, app_call_kind_t kind) const;
 };
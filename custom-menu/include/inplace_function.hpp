@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template<typename Signature, std::size_t Capacity>
+class inplace_function;
+
+/**
+ * A move-only std::function that never allocates. The callable lives in a fixed buffer inside the object, and one that
+ * doesn't fit is a compile error.
+ */
+template<typename R, typename... Args, std::size_t Capacity>
+class inplace_function<R(Args...), Capacity> {
+  using invoke_fn_t = R (*)(void *storage, Args &&...args);
+  // Move-constructs the callable from src into dst (if not null), then destroys the one in src
+  using relocate_fn_t = void (*)(void *dst, void *src);
+
+  alignas(std::max_align_t) std::byte storage[Capacity]{};
+  invoke_fn_t invoke_fn = nullptr;
+  relocate_fn_t relocate_fn = nullptr;
+
+  void reset() {
+    if (relocate_fn)
+      relocate_fn(nullptr, storage);
+    invoke_fn = nullptr;
+    relocate_fn = nullptr;
+  }
+
+public:
+  inplace_function() = default;
+
+  // ReSharper disable once CppNonExplicitConvertingConstructor
+  inplace_function(std::nullptr_t) {}
+
+  template<typename F, typename T = std::decay_t<F>>
+    requires(!std::is_same_v<T, inplace_function> && std::is_invocable_r_v<R, T &, Args...>)
+  // ReSharper disable once CppNonExplicitConvertingConstructor
+  inplace_function(F &&f) {
+    static_assert(sizeof(T) <= Capacity, "Callable is too large for this inplace_function");
+    static_assert(alignof(T) <= alignof(std::max_align_t), "Callable is over-aligned for this inplace_function");
+    static_assert(std::is_nothrow_move_constructible_v<T>, "Callable must be nothrow move constructible");
+
+    // Empty function pointers and std::functions stay empty
+    if constexpr (requires(const T &t) { t == nullptr; }) {
+      if (f == nullptr)
+        return;
+    }
+
+    ::new (static_cast<void *>(storage)) T(std::forward<F>(f));
+    invoke_fn = [](void *obj, Args &&...args) -> R {
+      return std::invoke(*static_cast<T *>(obj), std::forward<Args>(args)...);
+    };
+    relocate_fn = [](void *dst, void *src) {
+      if (dst)
+        ::new (dst) T(std::move(*static_cast<T *>(src)));
+      static_cast<T *>(src)->~T();
+    };
+  }
+
+  inplace_function(const inplace_function &) = delete;
+  inplace_function &operator=(const inplace_function &) = delete;
+
+  inplace_function(inplace_function &&other) noexcept { *this = std::move(other); }
+
+  inplace_function &operator=(inplace_function &&other) noexcept {
+    if (this != &other) {
+      reset();
+      if (other.relocate_fn) {
+        other.relocate_fn(storage, other.storage);
+        invoke_fn = other.invoke_fn;
+        relocate_fn = other.relocate_fn;
+        other.invoke_fn = nullptr;
+        other.relocate_fn = nullptr;
+      }
+    }
+    return *this;
+  }
+
+  inplace_function &operator=(std::nullptr_t) {
+    reset();
+    return *this;
+  }
+
+  ~inplace_function() { reset(); }
+
+  R operator()(Args... args) { return invoke_fn(storage, std::forward<Args>(args)...); }
+
+  explicit operator bool() const { return invoke_fn != nullptr; }
+};
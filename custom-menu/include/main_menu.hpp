@@ -17,6 +17,11 @@ public:
 
   void load_app_actions(display_controller &controller);
 
+  /**
+   * Rebuild the menu after apps were added or removed while it's showing.
+   */
+  void on_apps_changed(display_controller &controller);
+
   void on_enter(app_api_t);
 
   void on_leave(app_api_t);
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+
+/**
+ * Bounded lock-free queue for any number of producers and a single consumer (Vyukov's bounded queue). Each cell carries
+ * a sequence number telling producers whether it's free and the consumer whether it's been published.
+ */
+template<typename T, std::size_t Capacity>
+class mpsc_queue {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+  static_assert(std::is_trivially_copyable_v<T>, "Queued values must be trivially copyable");
+
+  struct cell {
+    std::atomic<std::size_t> sequence;
+    T value;
+  };
+
+  std::array<cell, Capacity> cells;
+  alignas(64) std::atomic<std::size_t> enqueue_pos = 0;
+  alignas(64) std::size_t dequeue_pos = 0;
+
+public:
+  mpsc_queue() {
+    for (std::size_t i = 0; i < Capacity; ++i)
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  mpsc_queue(const mpsc_queue &) = delete;
+  mpsc_queue &operator=(const mpsc_queue &) = delete;
+
+  /**
+   * Add a value to the queue. Safe to call from any thread.
+   *
+   * @return false if the queue is full
+   */
+  bool try_push(const T &value) {
+    std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    cell *c;
+    while (true) {
+      c = &cells[pos & (Capacity - 1)];
+      const std::size_t sequence = c->sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+      if (diff == 0) {
+        if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+
+    c->value = value;
+    c->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Take the oldest value out of the queue. Must only be called from the consumer thread.
+   *
+   * @return The value, or nothing if the queue is empty or the next value isn't published yet
+   */
+  std::optional<T> try_pop() {
+    cell &c = cells[dequeue_pos & (Capacity - 1)];
+    const std::size_t sequence = c.sequence.load(std::memory_order_acquire);
+    if (static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(dequeue_pos + 1) < 0)
+      return std::nullopt;
+
+    T value = c.value;
+    c.sequence.store(dequeue_pos + Capacity, std::memory_order_release);
+    ++dequeue_pos;
+    return value;
+  }
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <csignal>
+
+/**
+ * Install a signal handler with sigaction, keeping the host's handler so ours can pass the signal on to it.
+ *
+ * @param sig The signal to handle
+ * @param handler The new handler
+ * @param previous Receives the handler that was installed before
+ * @return Whether the handler was installed
+ */
+inline bool
+install_signal_handler(const int sig, void (*handler)(int, siginfo_t *, void *), struct sigaction &previous) {
+  struct sigaction action{};
+  action.sa_sigaction = handler;
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  return sigaction(sig, &action, &previous) == 0;
+}
+
+/**
+ * Pass a signal on to the handler that was installed before ours. Default and ignore dispositions are left alone.
+ */
+inline void chain_signal_handler(const struct sigaction &previous, const int sig, siginfo_t *info, void *context) {
+  if (previous.sa_flags & SA_SIGINFO) {
+    if (previous.sa_sigaction != nullptr)
+      previous.sa_sigaction(sig, info, context);
+  } else if (previous.sa_handler != SIG_DFL && previous.sa_handler != SIG_IGN) {
+    previous.sa_handler(sig);
+  }
+}
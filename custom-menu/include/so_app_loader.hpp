@@ -1,5 +1,19 @@
 #pragma once
 #include "apps/app_api.hpp"
 
+/**
+ * Load a shared object app.
+ *
+ * @param userptr A std::map<std::string, void *> the handle is stored in, by app path
+ */
 app_descriptor *
 load_app_shared_object(void *userptr, app_api_t controller_api, const char *app_path, void **app_userptr);
+
+/**
+ * Close the handle of a shared object app once it's been torn down. Does nothing for apps that weren't loaded by
+ * load_app_shared_object.
+ *
+ * @param userptr The map passed to load_app_shared_object
+ * @param app_path The path to the app file
+ */
+void unload_app_shared_object(void *userptr, const char *app_path);
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Small pool of worker threads running tasks off the event loop. Workers are started as tasks are queued, up to a
+ * fixed number, and stay around once started.
+ *
+ * Tasks are tagged with an owner, which can have a limited number of them in flight at once. Finished tasks aren't
+ * completed on the workers: their completion callbacks are queued, and the pool only signals that some are ready, so
+ * whoever owns the pool can run them on its own thread with run_finished.
+ *
+ * Canceling a task that hasn't started drops it. One that's already running can't be interrupted, it runs to the end.
+ * Either way, its completion callback runs with canceled set.
+ */
+class task_pool {
+public:
+  using task_t = std::function<void()>;
+  using done_t = std::function<void(bool canceled)>;
+
+private:
+  struct queued_task {
+    uint32_t id;
+    void *owner;
+    task_t task;
+    done_t done;
+  };
+
+  struct running_task {
+    uint32_t id;
+    void *owner;
+    bool canceled;
+  };
+
+  struct finished_task {
+    void *owner;
+    done_t done;
+    bool canceled;
+  };
+
+  const uint32_t max_workers;
+  const uint32_t capacity;
+  const uint32_t max_per_owner;
+  // Called on whichever thread finished or canceled a task, with no lock held
+  const std::function<void()> on_finished;
+
+  std::mutex mutex;
+  std::condition_variable work_cv;
+  // Notified whenever a running task returns
+  std::condition_variable idle_cv;
+  std::deque<queued_task> queue{};
+  std::vector<running_task> running{};
+  std::deque<finished_task> finished{};
+  // Tasks queued or running, by owner
+  std::map<void *, uint32_t> in_flight{};
+  std::vector<std::thread> workers{};
+  uint32_t idle_workers = 0;
+  uint32_t next_id = 1;
+  bool stopping = false;
+
+  void worker_loop();
+
+  void release_in_flight(void *owner);
+
+public:
+  /**
+   * @param max_workers The most worker threads to run, 0 to refuse all tasks
+   * @param capacity The most tasks that may be waiting for a worker
+   * @param max_per_owner The most tasks an owner may have queued or running
+   * @param on_finished Called when completion callbacks are ready to be run with run_finished
+   */
+  task_pool(uint32_t max_workers, uint32_t capacity, uint32_t max_per_owner, std::function<void()> on_finished);
+
+  ~task_pool();
+
+  task_pool(const task_pool &) = delete;
+  task_pool &operator=(const task_pool &) = delete;
+
+  /**
+   * Queue a task. Safe to call from any thread.
+   *
+   * @param owner Opaque tag handed back with the completion callback, tasks can be canceled by owner
+   * @param task Run on a worker thread
+   * @param done Run by run_finished once the task is done or canceled
+   * @return The task ID, or 0 if the queue is full or the owner has too many tasks in flight
+   */
+  uint32_t post(void *owner, task_t &&task, done_t &&done);
+
+  /**
+   * Cancel a task. Safe to call from any thread.
+   *
+   * @param task_id The ID returned by post
+   * @return Whether the task was still queued or running
+   */
+  bool cancel(uint32_t task_id);
+
+  /**
+   * Cancel all of an owner's tasks.
+   *
+   * @param owner The owner the tasks were posted with
+   * @param wait Whether to wait for its running tasks to return, i.e. before unloading the code they run
+   */
+  void cancel_owner(void *owner, bool wait);
+
+  /**
+   * Stop the workers, waiting for the tasks they're running. Queued tasks are dropped without being completed.
+   */
+  void stop();
+
+  /**
+   * Run the completion callbacks of the tasks that finished or were canceled, in the order they did.
+   *
+   * @param run Called as run(owner, done, canceled) for each of them
+   */
+  template<typename Run>
+  void run_finished(Run &&run) {
+    // Callbacks may post or cancel tasks, and those finished in the meantime are left for the next call
+    std::deque<finished_task> ready;
+    {
+      std::scoped_lock lock(mutex);
+      ready.swap(finished);
+    }
+    for (auto &task : ready)
+      run(task.owner, task.done, task.canceled);
+  }
+};
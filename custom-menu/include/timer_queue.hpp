@@ -0,0 +1,292 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <optional>
+
+#include "inplace_function.hpp"
+
+/**
+ * Timers stored in a fixed pool of nodes, ordered by two indexed binary heaps: one on when they expire, and one on the
+ * latest time they may run at, their expiration plus slack. Waking up at the earliest such deadline and running every
+ * timer that expired by then lets timers with overlapping windows share a wakeup.
+ *
+ * Timer IDs are a pool slot plus a generation counter, so looking one up is O(1) and stale IDs are rejected. Timers can
+ * be scheduled and canceled from inside callbacks, including the running timer canceling itself.
+ */
+class timer_queue {
+public:
+  using clock = std::chrono::steady_clock;
+  // Big enough for the std::function apps hand us through the C++ API
+  using callback_t = inplace_function<void(), sizeof(std::function<void()>)>;
+
+  static constexpr uint32_t CAPACITY = 64;
+
+private:
+  static constexpr uint32_t SLOT_BITS = 8;
+  static constexpr uint32_t SLOT_MASK = (1 << SLOT_BITS) - 1;
+  static_assert(CAPACITY <= SLOT_MASK + 1, "Timer slots don't fit in the timer ID");
+
+  static constexpr uint16_t NOT_QUEUED = UINT16_MAX;
+
+  struct node {
+    callback_t callback{};
+    clock::time_point expiration{};
+    clock::time_point deadline{};
+    uint32_t interval_ms = 0;
+    std::optional<uint32_t> slack_ms = std::nullopt; // nothing to use the default
+    void *owner = nullptr;
+    uint32_t generation = 1;
+    uint16_t expiration_index = NOT_QUEUED;
+    uint16_t deadline_index = NOT_QUEUED;
+    bool in_use = false;
+    bool repeat = false;
+    bool running = false;
+    bool canceled = false;
+  };
+
+  std::array<node, CAPACITY> nodes{};
+
+  // Indexed binary heap of pool slots, ordered on one of the nodes' time points
+  template<clock::time_point node::*Key, uint16_t node::*Index>
+  class slot_heap {
+    std::array<node, CAPACITY> &nodes;
+    std::array<uint16_t, CAPACITY> slots{};
+    uint32_t count = 0;
+
+    [[nodiscard]] bool earlier(const uint32_t a, const uint32_t b) const {
+      return nodes[slots[a]].*Key < nodes[slots[b]].*Key;
+    }
+
+    void swap(const uint32_t a, const uint32_t b) {
+      std::swap(slots[a], slots[b]);
+      nodes[slots[a]].*Index = static_cast<uint16_t>(a);
+      nodes[slots[b]].*Index = static_cast<uint16_t>(b);
+    }
+
+    void sift_up(uint32_t i) {
+      while (i > 0 && earlier(i, (i - 1) / 2)) {
+        swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+      }
+    }
+
+    void sift_down(uint32_t i) {
+      while (true) {
+        uint32_t smallest = i;
+        for (const uint32_t child : { 2 * i + 1, 2 * i + 2 }) {
+          if (child < count && earlier(child, smallest))
+            smallest = child;
+        }
+        if (smallest == i)
+          return;
+        swap(i, smallest);
+        i = smallest;
+      }
+    }
+
+  public:
+    explicit slot_heap(std::array<node, CAPACITY> &nodes) : nodes(nodes) {}
+
+    void push(const uint16_t slot) {
+      slots[count] = slot;
+      nodes[slot].*Index = static_cast<uint16_t>(count);
+      sift_up(count++);
+    }
+
+    void remove(const uint16_t slot) {
+      const uint32_t i = nodes[slot].*Index;
+      nodes[slot].*Index = NOT_QUEUED;
+      if (i == --count)
+        return;
+      slots[i] = slots[count];
+      nodes[slots[i]].*Index = static_cast<uint16_t>(i);
+      sift_up(i);
+      sift_down(nodes[slots[i]].*Index);
+    }
+
+    [[nodiscard]] std::optional<uint16_t> top() const {
+      return count > 0 ? std::optional(slots[0]) : std::nullopt;
+    }
+
+    [[nodiscard]] uint32_t size() const { return count; }
+  };
+
+  slot_heap<&node::expiration, &node::expiration_index> by_expiration{ nodes };
+  slot_heap<&node::deadline, &node::deadline_index> by_deadline{ nodes };
+  std::array<uint16_t, CAPACITY> free_slots{};
+  uint32_t free_count = 0;
+
+  void enqueue(const uint16_t slot, const clock::time_point expiration, const uint32_t default_slack_ms) {
+    node &n = nodes[slot];
+    n.expiration = expiration;
+    n.deadline = expiration + std::chrono::milliseconds(n.slack_ms.value_or(default_slack_ms));
+    by_expiration.push(slot);
+    by_deadline.push(slot);
+  }
+
+  void dequeue(const uint16_t slot) {
+    by_expiration.remove(slot);
+    by_deadline.remove(slot);
+  }
+
+  void release(const uint16_t slot) {
+    node &n = nodes[slot];
+    n.callback = nullptr;
+    n.in_use = false;
+    // Generation 0 would make slot 0 hand out timer ID 0
+    if (++n.generation > UINT32_MAX >> SLOT_BITS)
+      n.generation = 1;
+    free_slots[free_count++] = slot;
+  }
+
+  [[nodiscard]] node *lookup(const uint32_t timer_id) {
+    const uint32_t slot = timer_id & SLOT_MASK;
+    if (slot >= CAPACITY)
+      return nullptr;
+    node &n = nodes[slot];
+    return n.in_use && n.generation == timer_id >> SLOT_BITS ? &n : nullptr;
+  }
+
+public:
+  timer_queue() {
+    for (uint32_t i = 0; i < CAPACITY; ++i)
+      free_slots[i] = static_cast<uint16_t>(CAPACITY - 1 - i);
+    free_count = CAPACITY;
+  }
+
+  timer_queue(const timer_queue &) = delete;
+  timer_queue &operator=(const timer_queue &) = delete;
+
+  /**
+   * Add a timer to the queue.
+   *
+   * @param callback The callback to call when the timer expires
+   * @param expiration When the timer first expires
+   * @param interval_ms The interval between runs of a repeating timer
+   * @param repeat Whether the timer should repeat
+   * @param slack_ms How late the timer may run, or nothing to use the default
+   * @param default_slack_ms The current default slack
+   * @param owner Opaque tag handed back when the timer runs
+   * @return The timer ID, or 0 if the pool is exhausted
+   */
+  uint32_t schedule(callback_t &&callback,
+                    const clock::time_point expiration,
+                    const uint32_t interval_ms,
+                    const bool repeat,
+                    const std::optional<uint32_t> slack_ms,
+                    const uint32_t default_slack_ms,
+                    void *owner = nullptr) {
+    if (free_count == 0) {
+      std::cerr << "Timer pool exhausted, dropping timer\n";
+      return 0;
+    }
+
+    const uint16_t slot = free_slots[--free_count];
+    node &n = nodes[slot];
+    n.callback = std::move(callback);
+    n.interval_ms = interval_ms;
+    n.slack_ms = slack_ms;
+    n.owner = owner;
+    n.in_use = true;
+    n.repeat = repeat;
+    n.running = false;
+    n.canceled = false;
+    enqueue(slot, expiration, default_slack_ms);
+    return n.generation << SLOT_BITS | slot;
+  }
+
+  /**
+   * Cancel a timer. A timer canceling itself from its own callback is released once the callback returns.
+   *
+   * @param timer_id The ID returned by schedule
+   * @return Whether the timer was still pending
+   */
+  bool cancel(const uint32_t timer_id) {
+    node *n = lookup(timer_id);
+    if (n == nullptr || n->canceled)
+      return false;
+
+    if (n->running) {
+      n->canceled = true;
+    } else {
+      const auto slot = static_cast<uint16_t>(timer_id & SLOT_MASK);
+      dequeue(slot);
+      release(slot);
+    }
+    return true;
+  }
+
+  /**
+   * Cancel all the timers scheduled with an owner, i.e. before unloading the code their callbacks run. A timer that's
+   * running is released once its callback returns.
+   *
+   * @param owner The owner the timers were scheduled with
+   * @return How many timers were canceled
+   */
+  uint32_t cancel_owner(const void *owner) {
+    uint32_t canceled = 0;
+    for (uint16_t slot = 0; slot < CAPACITY; ++slot) {
+      node &n = nodes[slot];
+      if (!n.in_use || n.canceled || n.owner != owner)
+        continue;
+      if (n.running) {
+        n.canceled = true;
+      } else {
+        dequeue(slot);
+        release(slot);
+      }
+      ++canceled;
+    }
+    return canceled;
+  }
+
+  /**
+   * Run the callbacks of all timers that expired at or before now, in expiration order. Repeating timers are
+   * rescheduled at least min_interval_ms after now.
+   *
+   * @param now The current time
+   * @param min_interval_ms The minimum interval between runs of a repeating timer
+   * @param default_slack_ms The slack of rescheduled timers that use the default
+   * @param run Called as run(owner, callback) to run each timer
+   */
+  template<typename Run>
+  void run_expired(const clock::time_point now,
+                   const uint32_t min_interval_ms,
+                   const uint32_t default_slack_ms,
+                   Run &&run) {
+    for (auto slot = by_expiration.top(); slot && nodes[*slot].expiration <= now; slot = by_expiration.top()) {
+      dequeue(*slot);
+
+      node &n = nodes[*slot];
+      n.running = true;
+      try {
+        run(n.owner, n.callback);
+      } catch (...) {
+        std::cerr << "Exception in timer callback\n";
+      }
+      n.running = false;
+
+      if (n.repeat && !n.canceled) {
+        enqueue(*slot, now + std::chrono::milliseconds(std::max(n.interval_ms, min_interval_ms)), default_slack_ms);
+      } else {
+        release(*slot);
+      }
+    }
+  }
+
+  /**
+   * @return The latest time the next timer may run at
+   */
+  [[nodiscard]] std::optional<clock::time_point> next_deadline() const {
+    if (const auto slot = by_deadline.top())
+      return nodes[*slot].deadline;
+    return std::nullopt;
+  }
+
+  [[nodiscard]] uint32_t size() const { return by_expiration.size(); }
+};
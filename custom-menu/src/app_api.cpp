@@ -29,6 +29,10 @@ uint16_t app_api_get_font(const c_app_api_t controller_api, const char *font_nam
   return FONT_NOT_FOUND;
 }
 
+uint32_t app_api_get_font_generation(const c_app_api_t controller_api) {
+  return get_display_controller(controller_api).get_font_generation();
+}
+
 void app_api_clay_render(const app_api_t controller_api, const Clay_RenderCommandArray *cmds) {
   get_display_controller(controller_api).clay_render(*cmds);
 }
@@ -37,6 +41,14 @@ void app_api_draw_frame(const app_api_t controller_api, const uint16_t *buf, con
   get_display_controller(controller_api).draw_frame(std::span(buf, buf_size));
 }
 
+void app_api_show_toast(const app_api_t controller_api, const char *text, const uint32_t duration_ms) {
+  get_display_controller(controller_api).show_toast(text, duration_ms);
+}
+
+void app_api_hide_toast(const app_api_t controller_api) {
+  get_display_controller(controller_api).hide_toast();
+}
+
 void app_api_goto_main_menu(app_api_t controller_api) {
   get_display_controller(controller_api).goto_main_menu();
 }
@@ -57,7 +69,23 @@ uint32_t app_api_schedule_timer(app_api_t controller_api,
                                 const uint32_t repeat,
                                 void (*callback)(void *userptr),
                                 void *userptr) {
-  return get_display_controller(controller_api).schedule_timer(callback, time, repeat != 0, userptr);
+  auto &controller = get_display_controller(controller_api);
+  return controller.schedule_timer(callback, time, repeat != 0, userptr, std::nullopt, controller.get_running_app());
+}
+
+static std::optional<uint32_t> to_slack(const uint32_t slack_ms) {
+  return slack_ms == TIMER_SLACK_DEFAULT ? std::nullopt : std::optional(slack_ms);
+}
+
+uint32_t app_api_schedule_timer_with_slack(app_api_t controller_api,
+                                           const uint32_t time,
+                                           const uint32_t repeat,
+                                           const uint32_t slack_ms,
+                                           void (*callback)(void *userptr),
+                                           void *userptr) {
+  auto &controller = get_display_controller(controller_api);
+  return controller.schedule_timer(
+    callback, time, repeat != 0, userptr, to_slack(slack_ms), controller.get_running_app());
 }
 
 namespace priv_api {
@@ -65,7 +93,18 @@ uint32_t app_api_schedule_stdfn_timer(app_api_t controller_api,
                                       const uint32_t time,
                                       const uint32_t repeat,
                                       std::function<void()> &&callback) {
-  return get_display_controller(controller_api).schedule_timer(std::move(callback), time, repeat != 0);
+  return app_api_schedule_stdfn_timer_with_slack(
+    controller_api, time, repeat, TIMER_SLACK_DEFAULT, std::move(callback));
+}
+
+uint32_t app_api_schedule_stdfn_timer_with_slack(app_api_t controller_api,
+                                                 const uint32_t time,
+                                                 const uint32_t repeat,
+                                                 const uint32_t slack_ms,
+                                                 std::function<void()> &&callback) {
+  auto &controller = get_display_controller(controller_api);
+  return controller.schedule_timer(
+    std::move(callback), time, repeat != 0, to_slack(slack_ms), controller.get_running_app());
 }
 } // namespace priv_api
 
@@ -73,6 +112,27 @@ uint32_t app_api_cancel_timer(app_api_t controller_api, const uint32_t timer_id)
   return get_display_controller(controller_api).cancel_timer(timer_id);
 }
 
+uint32_t app_api_post_background_task(app_api_t controller_api,
+                                      const app_task_fn_t task_fn,
+                                      const app_task_done_fn_t done_fn,
+                                      void *userptr) {
+  return get_display_controller(controller_api)
+    .post_background_task([task_fn, userptr] { task_fn(userptr); },
+                          [done_fn, userptr](const bool canceled) { done_fn(userptr, canceled); });
+}
+
+namespace priv_api {
+uint32_t app_api_post_stdfn_background_task(app_api_t controller_api,
+                                            std::function<void()> &&task,
+                                            std::function<void(bool canceled)> &&done) {
+  return get_display_controller(controller_api).post_background_task(std::move(task), std::move(done));
+}
+} // namespace priv_api
+
+uint32_t app_api_cancel_background_task(app_api_t controller_api, const uint32_t task_id) {
+  return get_display_controller(controller_api).cancel_background_task(task_id);
+}
+
 measure_text_result_t app_api_clay_measure_text(app_api_t controller_api,
                                                 const char *text,
                                                 const size_t length,
@@ -84,3 +144,22 @@ measure_text_result_t app_api_clay_measure_text(app_api_t controller_api,
                                                     config);
   return { width, height };
 }
+
+size_t app_api_get_app_count(const c_app_api_t controller_api) {
+  return get_display_controller(controller_api).get_app_count();
+}
+
+const char *app_api_get_app_name(const c_app_api_t controller_api, const size_t app_index) {
+  return get_display_controller(controller_api).get_app_name(app_index);
+}
+
+bool app_api_get_app_call_stats(const c_app_api_t controller_api,
+                                const size_t app_index,
+                                const app_call_kind_t kind,
+                                app_call_stats_t *stats) {
+  const auto result = get_display_controller(controller_api).get_app_call_stats(app_index, kind);
+  if (!result)
+    return false;
+  *stats = *result;
+  return true;
+}
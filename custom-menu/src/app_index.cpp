@@ -0,0 +1,203 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "app_index.hpp"
+#include "debug.h"
+
+namespace fs = std::filesystem;
+
+static constexpr int APP_INDEX_VERSION = 1;
+
+static std::optional<fs::path> deref_symlink(fs::path p) {
+  for (int i = 0; i < 10; ++i) {
+    if (!fs::is_symlink(p)) {
+      return p;
+    }
+    std::error_code ec;
+    fs::path target = fs::read_symlink(p, ec);
+    if (ec) {
+      std::cerr << "Failed to read symlink: " << p << " - " << ec.message() << std::endl;
+      return std::nullopt;
+    }
+    fs::path next_path = p.parent_path() / target;
+    p = next_path.lexically_normal();
+  }
+  std::cerr << "Too many levels of symlinks: " << p << std::endl;
+  return std::nullopt;
+}
+
+/**
+ * Read the manifest next to an app, named after the app file with ".manifest" appended. It's made of "key=value" lines:
+ * "name" is the name shown in the main menu, and "background" set to "true" has the app loaded at startup, for apps
+ * that need to run without being entered, such as ones that register app loaders.
+ *
+ * @param app_path The path to the app file
+ * @return The manifest, or nothing if the app doesn't have a valid one
+ */
+static std::optional<app_manifest> load_app_manifest(const fs::path &app_path) {
+  fs::path manifest_path = app_path;
+  manifest_path += ".manifest";
+  std::ifstream file(manifest_path);
+  if (!file.is_open())
+    return std::nullopt;
+
+  app_manifest manifest;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    const size_t eq = line.find('=');
+    if (eq == std::string::npos) {
+      std::cerr << "Invalid line in app manifest " << manifest_path << ": " << line << std::endl;
+      return std::nullopt;
+    }
+    const std::string key = line.substr(0, eq);
+    const std::string value = line.substr(eq + 1);
+    if (key == "name") {
+      manifest.name = value;
+    } else if (key == "background") {
+      manifest.background = value == "true";
+    } else {
+      std::cerr << "Unknown key in app manifest " << manifest_path << ": " << key << std::endl;
+    }
+  }
+
+  if (manifest.name.empty()) {
+    std::cerr << "App manifest has no name: " << manifest_path << std::endl;
+    return std::nullopt;
+  }
+  return manifest;
+}
+
+static std::optional<fs::path> index_path(const fs::path &dir) {
+  if (std::string_view(APP_INDEX_DIR).empty())
+    return std::nullopt;
+
+  std::error_code ec;
+  std::string name = fs::absolute(dir, ec).lexically_normal().string();
+  if (ec)
+    return std::nullopt;
+  while (name.size() > 1 && name.back() == '/')
+    name.pop_back();
+  for (char &c : name) {
+    if (c == '/')
+      c = '_';
+  }
+  return fs::path(APP_INDEX_DIR) / (name + ".idx");
+}
+
+// Index format: a "version dir_mtime" header, then one tab separated line per app
+static std::optional<std::vector<app_index_entry>> read_index(const fs::path &path, const int64_t dir_mtime) {
+  std::ifstream file(path);
+  if (!file.is_open())
+    return std::nullopt;
+
+  int version = 0;
+  int64_t indexed_mtime = 0;
+  if (!(file >> version >> indexed_mtime) || version != APP_INDEX_VERSION || indexed_mtime != dir_mtime)
+    return std::nullopt;
+  file.ignore(1);
+
+  std::vector<app_index_entry> entries;
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    app_index_entry entry;
+    std::string app_path;
+    int has_manifest = 0;
+    int background = 0;
+    if (!std::getline(fields, app_path, '\t') || !(fields >> entry.mtime >> entry.size) || !fields.ignore(1) ||
+        !std::getline(fields, entry.extension, '\t') || !(fields >> has_manifest >> background) || !fields.ignore(1)) {
+      std::cerr << "Corrupt app index: " << path << std::endl;
+      return std::nullopt;
+    }
+    entry.path = app_path;
+    if (has_manifest) {
+      entry.manifest = app_manifest{ .background = background != 0 };
+      std::getline(fields, entry.manifest->name);
+    }
+    entries.push_back(std::move(entry));
+  }
+  return entries;
+}
+
+static void write_index(const fs::path &path, const int64_t dir_mtime, const std::vector<app_index_entry> &entries) {
+  for (const auto &entry : entries) {
+    // These would break the line format, and don't deserve their own escaping
+    if (entry.path.string().find_first_of("\t\n") != std::string::npos ||
+        entry.extension.find_first_of("\t\n") != std::string::npos)
+      return;
+  }
+
+  std::error_code ec;
+  fs::create_directories(path.parent_path(), ec);
+  fs::path tmp_path = path;
+  tmp_path += ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::trunc);
+    if (!file.is_open())
+      return;
+    file << APP_INDEX_VERSION << ' ' << dir_mtime << '\n';
+    for (const auto &entry : entries) {
+      file << entry.path.string() << '\t' << entry.mtime << '\t' << entry.size << '\t' << entry.extension << '\t'
+           << entry.manifest.has_value() << '\t' << (entry.manifest && entry.manifest->background) << '\t'
+           << (entry.manifest ? entry.manifest->name : "") << '\n';
+    }
+    if (!file.good())
+      return;
+  }
+  fs::rename(tmp_path, path, ec);
+  if (ec)
+    std::cerr << "Failed to write app index: " << path << " - " << ec.message() << std::endl;
+}
+
+static std::vector<app_index_entry> list_app_directory(const fs::path &dir) {
+  std::vector<app_index_entry> entries;
+  for (const auto &dir_entry : fs::directory_iterator(dir)) {
+    if (dir_entry.path().extension() == ".manifest")
+      continue;
+    const auto realpath = deref_symlink(dir_entry.path());
+    if (!realpath.has_value())
+      continue;
+    std::error_code ec;
+    const auto status = fs::status(*realpath, ec);
+    if (ec || !fs::is_regular_file(status))
+      continue;
+
+    app_index_entry entry{ .path = *realpath, .extension = realpath->extension().string() };
+    entry.mtime = fs::last_write_time(*realpath, ec).time_since_epoch().count();
+    entry.size = fs::file_size(*realpath, ec);
+    entry.manifest = load_app_manifest(*realpath);
+    entries.push_back(std::move(entry));
+  }
+  return entries;
+}
+
+std::vector<app_index_entry> scan_app_directory(const fs::path &dir, const bool use_index) {
+  const auto start = std::chrono::steady_clock::now();
+
+  std::error_code ec;
+  const int64_t dir_mtime = fs::last_write_time(dir, ec).time_since_epoch().count();
+  const auto path = ec ? std::nullopt : index_path(dir);
+
+  [[maybe_unused]] bool cached = false;
+  std::vector<app_index_entry> entries;
+  if (auto indexed = path && use_index ? read_index(*path, dir_mtime) : std::nullopt) {
+    entries = std::move(*indexed);
+    cached = true;
+  } else {
+    entries = list_app_directory(dir);
+    if (path)
+      write_index(*path, dir_mtime, entries);
+  }
+
+  const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  debugf("app index: %s: %zu files %s in %.1f ms\n",
+         dir.c_str(),
+         entries.size(),
+         cached ? "from index" : "scanned",
+         elapsed.count());
+  return entries;
+}
@@ -1,15 +1,50 @@
 #include <cassert>
+#include <csignal>
+#include <cstring>
 #include <dlfcn.h>
 #include <filesystem>
+#include <fstream>
+#include <limits>
 #include <mutex>
+#include <set>
+#include <unistd.h>
+#if __has_include(<execinfo.h>)
+#include <execinfo.h>
+#endif
+#ifdef APP_HOT_RELOAD
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
 
 #include "display_controller.hpp"
 #include "hooked_functions.h"
 #include "main_menu.hpp"
+#include "signal_chain.hpp"
 #include "so_app_loader.hpp"
 
 namespace fs = std::filesystem;
 
+#if __has_include(<execinfo.h>)
+// Sent to the event loop thread to have it print its stack while an app hangs it
+#define WATCHDOG_STACK_SIGNAL (SIGRTMIN + 1)
+
+static struct sigaction host_stack_signal_action{};
+static bool stack_signal_installed = false;
+// Set by the watchdog right before it sends the signal, anything else is passed on to the host's handler
+static std::atomic<bool> stack_dump_requested = false;
+
+static void print_stack_signal_handler(const int sig, siginfo_t *info, void *context) {
+  if (!stack_dump_requested.exchange(false)) {
+    chain_signal_handler(host_stack_signal_action, sig, info, context);
+    return;
+  }
+  void *frames[64];
+  const int count = backtrace(frames, static_cast<int>(std::size(frames)));
+  backtrace_symbols_fd(frames, count, STDERR_FILENO);
+}
+#endif
+
 // ReSharper disable once CppPassValueParameterByConstReference
 // ReSharper disable once CppParameterMayBeConstPtrOrRef
 static Clay_Dimensions clay_measure_text_impl(Clay_StringSlice text, Clay_TextElementConfig *config, void *userData) {
@@ -18,22 +53,37 @@ static Clay_Dimensions clay_measure_text_impl(Clay_StringSlice text, Clay_TextEl
     abort();
   }
 
-  const display_controller *ctrl = static_cast<display_controller *>(userData);
-  const font_registry_t &reg = ctrl->get_font_registry();
-  if (config->fontId >= reg.size()) {
-    std::cerr << "ClayMeasureText: invalid fontId " << config->fontId << '\n';
+  auto *ctrl = static_cast<display_controller *>(userData);
+  const std::string_view sv{ text.chars, static_cast<std::string_view::size_type>(text.length) };
+  const auto [width, height] = ctrl->measure_text(config->fontId, sv);
+  return Clay_Dimensions{ static_cast<float>(width), static_cast<float>(height) };
+}
+
+BitmapFont::TextMetrics display_controller::measure_text(const uint16_t font_id, const std::string_view text) {
+  if (font_id >= font_registry.size()) {
+    std::cerr << "ClayMeasureText: invalid fontId " << font_id << '\n';
     abort();
   }
 
-  const BitmapFont *font = reg[config->fontId];
+  const BitmapFont *font = font_registry[font_id];
   if (!font) {
-    std::cerr << "ClayMeasureText: font is null " << config->fontId << '\n';
+    std::cerr << "ClayMeasureText: font is null " << font_id << '\n';
     abort();
   }
 
-  const std::string_view sv{ text.chars, static_cast<std::string_view::size_type>(text.length) };
-  const auto [width, height] = font->measure(sv);
-  return Clay_Dimensions{ static_cast<float>(width), static_cast<float>(height) };
+  return text_measure_cache.measure(*font, font_id, text);
+}
+
+uint16_t display_controller::add_font(const BitmapFont *font) {
+  assert(font != nullptr);
+  // The render thread reads the registry and owns the text run cache
+  flush_render_thread();
+  font_registry.push_back(font);
+  ++font_generation;
+  text_measure_cache.invalidate();
+  text_run_cache.clear();
+  Clay_ResetMeasureTextCache();
+  return static_cast<uint16_t>(font_registry.size() - 1);
 }
 
 Clay_Dimensions display_controller::clay_measure_text(const Clay_StringSlice &text, Clay_TextElementConfig *config) {
@@ -54,82 +104,723 @@ display_controller::display_controller() {
 
   Clay_Initialize(arena, Clay_Dimensions{ 128, 128 }, errHandler);
   Clay_SetMeasureTextFunction(&clay_measure_text_impl, this);
+#ifdef RENDER_THREAD
+  render_thread = std::thread([this] { render_thread_loop(); });
+#endif
   load_apps();
+  event_thread = std::thread([this] { event_loop(); });
+  if constexpr (APP_CALLBACK_HANG_MS > 0) {
+#if __has_include(<execinfo.h>)
+    // backtrace() may allocate the first time it's called, which it can't do in a signal handler
+    void *frame;
+    backtrace(&frame, 1);
+    stack_signal_installed =
+      install_signal_handler(WATCHDOG_STACK_SIGNAL, print_stack_signal_handler, host_stack_signal_action);
+#endif
+    watchdog_thread = std::thread([this] { watchdog_loop(); });
+  }
+#ifdef APP_HOT_RELOAD
+  watch_app_directories();
+#endif
 }
 
 display_controller::~display_controller() {
+  if (watchdog_thread.joinable()) {
+    {
+      std::scoped_lock lock(watchdog_mutex);
+      watchdog_stop = true;
+    }
+    watchdog_cv.notify_all();
+    watchdog_thread.join();
+  }
+#ifdef APP_HOT_RELOAD
+  stop_watching_app_directories();
+#endif
+  // The stop event must not be dropped
+  while (!events.try_push({ .type = event_type::stop }))
+    std::this_thread::yield();
+  wake_event_loop();
+  event_thread.join();
+
   set_active_app(std::nullopt);
+  // Queued frames may point at the apps' images
+  flush_render_thread();
   app_loaders.clear();
-  for (auto &[descriptor, userptr] : apps) {
-    if (descriptor.on_teardown)
-      descriptor.on_teardown(userptr, this);
+  for (auto &app : apps) {
+    cancel_app_tasks(app);
+    if (app.descriptor.on_teardown)
+      app.descriptor.on_teardown(app.userptr, this);
+  }
+  tasks.stop();
+
+#ifdef RENDER_THREAD
+  {
+    std::scoped_lock lock(render_mutex);
+    render_stop = true;
+  }
+  render_cv.notify_all();
+  render_thread.join();
+#endif
+}
+
+void display_controller::post_event(const event &ev) {
+  if (!events.try_push(ev)) {
+    std::cerr << "Event queue full, dropping event\n";
+    return;
+  }
+  wake_event_loop();
+}
+
+void display_controller::wake_event_loop() {
+  event_signal.fetch_add(1, std::memory_order_release);
+  event_signal.notify_one();
+}
+
+void display_controller::event_loop() {
+  while (true) {
+    // Anything posted after this load changes the signal, so the wait below returns right away
+    const uint32_t seen = event_signal.load(std::memory_order_acquire);
+
+    if (heartbeat_fires.load(std::memory_order_relaxed) > 0)
+      on_heartbeat_timer();
+    if (app_stats_dump_requested.exchange(false, std::memory_order_relaxed))
+      dump_app_stats();
+    if (task_completions_pending.exchange(false, std::memory_order_relaxed))
+      run_task_completions();
+    while (const auto ev = events.try_pop()) {
+      if (ev->type == event_type::stop)
+        return;
+      handle_event(*ev);
+    }
+
+    event_signal.wait(seen, std::memory_order_acquire);
   }
 }
 
-static std::optional<fs::path> deref_symlink(fs::path p) {
-  for (int i = 0; i < 10; ++i) {
-    if (!fs::is_symlink(p)) {
-      return p;
+void display_controller::handle_event(const event &ev) {
+  switch (ev.type) {
+  case event_type::keypress:
+    // Key presses queued before the menu was closed belong to the stock UI, which can't get them back anymore
+    if (is_active)
+      on_keypress(ev.button);
+    break;
+  case event_type::toggle_active:
+    // Toggles that pile up are applied at once
+    set_active(host_active);
+    break;
+  case event_type::small_screen_detected:
+    switch_to_small_screen_mode();
+    break;
+  case event_type::unload_idle_apps:
+    unload_idle_apps();
+    break;
+  case event_type::apps_changed: {
+#ifdef APP_HOT_RELOAD
+    std::set<std::string> changed_paths;
+    {
+      std::scoped_lock lock(app_reload_mutex);
+      changed_paths.swap(app_reload_paths);
     }
-    std::error_code ec;
-    fs::path target = fs::read_symlink(p, ec);
-    if (ec) {
-      std::cerr << "Failed to read symlink: " << p << " - " << ec.message() << std::endl;
-      return std::nullopt;
+    reload_apps(changed_paths);
+#endif
+    break;
+  }
+  case event_type::stop_app:
+    stop_app(ev.app);
+    break;
+  case event_type::remove_app:
+    remove_app(ev.app);
+    break;
+  case event_type::stop:
+    break;
+  }
+}
+
+#ifdef APP_HOT_RELOAD
+void display_controller::watch_app_directories() {
+  app_watch_fd = inotify_init1(IN_CLOEXEC);
+  app_watch_stop_fd = eventfd(0, EFD_CLOEXEC);
+  if (app_watch_fd < 0 || app_watch_stop_fd < 0) {
+    std::cerr << "Failed to watch app directories: " << strerror(errno) << std::endl;
+    stop_watching_app_directories();
+    return;
+  }
+
+  for (const auto &path : app_lookup_paths)
+    watch_app_directory(path);
+  app_watch_thread = std::thread([this] { app_watch_loop(); });
+}
+
+// Lookup paths usually end with a slash, which would leave them without a file name
+static fs::path app_directory_path(const std::string &path) {
+  const fs::path dir(path);
+  return dir.has_filename() ? dir : dir.parent_path();
+}
+
+bool display_controller::watch_app_directory(const std::string &path) {
+  if (fs::is_directory(path)) {
+    constexpr uint32_t mask = IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB;
+    const int wd = inotify_add_watch(app_watch_fd, path.c_str(), mask);
+    if (wd < 0) {
+      std::cerr << "Failed to watch app directory " << path << ": " << strerror(errno) << std::endl;
+      return false;
+    }
+    app_watch_dirs[wd] = path;
+    return true;
+  }
+
+  const std::string parent = app_directory_path(path).parent_path().string();
+  if (parent.empty() || !fs::is_directory(parent))
+    return false;
+  const int wd = inotify_add_watch(app_watch_fd, parent.c_str(), IN_CREATE | IN_MOVED_TO);
+  if (wd < 0)
+    std::cerr << "Failed to watch app directory parent " << parent << ": " << strerror(errno) << std::endl;
+  else
+    app_watch_parents[wd] = parent;
+  return false;
+}
+
+void display_controller::app_watch_loop() {
+  // Copying an app in produces a burst of events, so the apps are only reloaded once the directories go quiet
+  std::set<std::string> changed_paths;
+  while (true) {
+    pollfd fds[] = { { .fd = app_watch_fd, .events = POLLIN }, { .fd = app_watch_stop_fd, .events = POLLIN } };
+    const int ready = poll(fds, std::size(fds), changed_paths.empty() ? -1 : APP_RELOAD_SETTLE_MS);
+    if (ready < 0) {
+      if (errno == EINTR)
+        continue;
+      std::cerr << "Failed to watch app directories: " << strerror(errno) << std::endl;
+      return;
+    }
+    if (fds[1].revents)
+      return;
+    if (ready == 0) {
+      {
+        std::scoped_lock lock(app_reload_mutex);
+        app_reload_paths.merge(changed_paths);
+      }
+      changed_paths.clear();
+      post_event({ .type = event_type::apps_changed });
+      continue;
+    }
+
+    alignas(inotify_event) char buf[4096];
+    const ssize_t length = read(app_watch_fd, buf, sizeof(buf));
+    for (ssize_t offset = 0; offset < length;) {
+      const auto *ev = reinterpret_cast<const inotify_event *>(buf + offset);
+      offset += static_cast<ssize_t>(sizeof(inotify_event) + ev->len);
+      const std::string_view name = ev->len > 0 ? ev->name : "";
+
+      // Any file may be an app run by a registered loader, or its manifest. Rescanning the directory is cheap, and
+      // only the apps whose files actually changed are reloaded.
+      if (const auto dir = app_watch_dirs.find(ev->wd); dir != app_watch_dirs.end()) {
+        changed_paths.insert(dir->second);
+        continue;
+      }
+      if (const auto parent = app_watch_parents.find(ev->wd); parent != app_watch_parents.end()) {
+        for (const auto &path : app_lookup_paths) {
+          const fs::path lookup_path = app_directory_path(path);
+          if (lookup_path.parent_path() == parent->second && lookup_path.filename() == name &&
+              watch_app_directory(path))
+            changed_paths.insert(path);
+        }
+      }
+    }
+  }
+}
+
+void display_controller::stop_watching_app_directories() {
+  if (app_watch_thread.joinable()) {
+    constexpr uint64_t one = 1;
+    if (write(app_watch_stop_fd, &one, sizeof(one)) != sizeof(one))
+      std::cerr << "Failed to stop watching app directories: " << strerror(errno) << std::endl;
+    app_watch_thread.join();
+  }
+  for (int *fd : { &app_watch_fd, &app_watch_stop_fd }) {
+    if (*fd >= 0)
+      close(*fd);
+    *fd = -1;
+  }
+}
+#endif
+
+app_stats *display_controller::get_app_stats(const std::string &app_path) {
+  auto [it, inserted] = app_call_stats.try_emplace(app_path);
+  if (inserted)
+    it->second.path = it->first;
+  return &it->second;
+}
+
+app_stats *display_controller::begin_app_call(app_stats *stats, const app_call_kind_t kind) {
+  app_stats *outer = std::exchange(running_app, stats);
+  if (outer == nullptr) {
+    app_call_owner.store(stats, std::memory_order_relaxed);
+    app_call_kind.store(kind, std::memory_order_relaxed);
+    app_call_started.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_release);
+  }
+  return outer;
+}
+
+void display_controller::end_app_call(app_stats *outer,
+                                      const app_call_kind_t kind,
+                                      const std::chrono::steady_clock::time_point start) {
+  app_stats *stats = std::exchange(running_app, outer);
+  if (outer == nullptr)
+    app_call_started.store(0, std::memory_order_release);
+  const auto duration = std::chrono::steady_clock::now() - start;
+  record_app_call(stats, kind, duration);
+
+  constexpr auto budget = std::chrono::milliseconds(APP_CALLBACK_BUDGET_MS);
+  if (budget.count() == 0 || (kind != APP_CALL_KEYPRESS && kind != APP_CALL_TIMER) || duration <= budget)
+    return;
+  ++stats->budget_strikes;
+  std::cerr << "App " << stats->path << " took "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(duration).count() << " ms in a "
+            << APP_CALL_KIND_NAMES[kind] << " callback, over the " << budget.count() << " ms budget ("
+            << stats->budget_strikes << "/" << APP_CALLBACK_STRIKES << ")" << std::endl;
+  // The app may still be on the stack, it's stopped once we're back in the event loop
+  if (APP_CALLBACK_STRIKES > 0 && stats->budget_strikes == APP_CALLBACK_STRIKES)
+    post_event({ .type = event_type::stop_app, .app = stats });
+}
+
+void display_controller::stop_app(app_stats *stats) {
+  const auto it = std::ranges::find(apps, stats, &app_entry::stats);
+  // The main menu is never stopped
+  if (it == apps.end() || it == apps.begin() || !it->loaded)
+    return;
+
+  std::cerr << "Stopping app " << it->name << ": too many callbacks over budget" << std::endl;
+  if (static_cast<size_t>(it - apps.begin()) == active_app_index) {
+    fatal_error("App stopped for being too slow", true);
+  } else if (it->on_demand) {
+    // Along with its pending timers
+    unload_app(*it);
+  } else {
+    // Background apps may be running the loaders of other apps
+    std::cerr << "Not stopping background app " << it->name << std::endl;
+  }
+}
+
+void display_controller::remove_app(app_stats *stats) {
+  const auto it = std::ranges::find(apps, stats, &app_entry::stats);
+  if (it == apps.end() || it == apps.begin())
+    return;
+  const auto index = static_cast<size_t>(it - apps.begin());
+  if (index == active_app_index)
+    set_active_app(0);
+
+  release_app(*it);
+  apps.erase(it);
+  if (active_app_index > index)
+    --*active_app_index;
+  // The menu's buttons point at the apps by index
+  if (active_app_index == 0)
+    static_cast<main_menu_app *>(apps[0].userptr)->on_apps_changed(*this);
+}
+
+void display_controller::run_task_completions() {
+  tasks.run_finished([this](void *owner, task_pool::done_t &done, const bool canceled) {
+    try {
+      call_app(static_cast<app_stats *>(owner), APP_CALL_TASK_DONE, [&] { done(canceled); });
+    } catch (...) {
+      std::cerr << "Exception in background task completion\n";
+    }
+  });
+}
+
+void display_controller::cancel_app_tasks(const app_entry &app) {
+  tasks.cancel_owner(app.stats, true);
+  run_task_completions();
+}
+
+uint32_t display_controller::post_background_task(task_pool::task_t &&task, task_pool::done_t &&done) {
+  app_stats *owner = running_app;
+  // Tasks are canceled along with their app, so they need one
+  if (owner == nullptr) {
+    std::cerr << "Background tasks can only be posted from app callbacks\n";
+    return 0;
+  }
+  return tasks.post(
+    owner,
+    [this, owner, task = std::move(task)] {
+      const auto start = std::chrono::steady_clock::now();
+      task();
+      record_app_call(owner, APP_CALL_TASK, std::chrono::steady_clock::now() - start);
+    },
+    std::move(done));
+}
+
+uint32_t display_controller::cancel_background_task(const uint32_t task_id) {
+  return tasks.cancel(task_id) ? 0 : 1;
+}
+
+void display_controller::watchdog_loop() {
+  constexpr auto hang_timeout = std::chrono::milliseconds(APP_CALLBACK_HANG_MS);
+  int64_t reported_call = 0;
+  std::unique_lock lock(watchdog_mutex);
+  while (!watchdog_cv.wait_for(lock, hang_timeout / 4, [this] { return watchdog_stop; })) {
+    const int64_t started = app_call_started.load(std::memory_order_acquire);
+    if (started == 0 || started == reported_call)
+      continue;
+    const auto running_for = std::chrono::steady_clock::now() -
+                             std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(started));
+    if (running_for < hang_timeout)
+      continue;
+
+    // Reported once per call, it may never return
+    reported_call = started;
+    const app_stats *stats = app_call_owner.load(std::memory_order_relaxed);
+    std::cerr << "Watchdog: app " << (stats ? stats->path : "?") << " has been stuck in a "
+              << APP_CALL_KIND_NAMES[app_call_kind.load(std::memory_order_relaxed)] << " callback for "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(running_for).count() << " ms" << std::endl;
+#if __has_include(<execinfo.h>)
+    // The event loop thread prints its own stack
+    if (stack_signal_installed) {
+      stack_dump_requested = true;
+      pthread_kill(event_thread.native_handle(), WATCHDOG_STACK_SIGNAL);
+    }
+#endif
+  }
+}
+
+void display_controller::record_app_call(app_stats *stats,
+                                         const app_call_kind_t kind,
+                                         const std::chrono::steady_clock::duration duration) {
+  if (stats == nullptr)
+    return;
+  std::scoped_lock lock(app_stats_mutex);
+  stats->calls[kind].record(duration);
+}
+
+void display_controller::dump_app_stats() const {
+  std::scoped_lock lock(app_stats_mutex);
+  std::cout << "App call stats (count, total, max, p99):" << std::endl;
+  for (const auto &app : apps) {
+    std::cout << "  " << app.name << (app.loaded ? "" : " (not loaded)") << std::endl;
+    for (uint32_t kind = 0; kind < APP_CALL_KIND_COUNT; ++kind) {
+      const app_call_stats_t stats = app.stats->calls[kind].summary();
+      if (stats.count == 0)
+        continue;
+      std::cout << "    " << APP_CALL_KIND_NAMES[kind] << ": " << stats.count << " calls, " << stats.total_us / 1000
+                << " ms, " << stats.max_us << " us, " << stats.p99_us << " us" << std::endl;
     }
-    fs::path next_path = p.parent_path() / target;
-    p = next_path.lexically_normal();
   }
-  std::cerr << "Too many levels of symlinks: " << p << std::endl;
-  return std::nullopt;
 }
 
-static bool app_file_sort(const fs::path &a, const fs::path &b) {
-  return a.filename().string() < b.filename().string();
+const char *display_controller::get_app_name(const size_t app_index) const {
+  return app_index < apps.size() ? apps[app_index].name.c_str() : nullptr;
+}
+
+std::optional<app_call_stats_t> display_controller::get_app_call_stats(const size_t app_index,
+                                                                       const app_call_kind_t kind) const {
+  if (app_index >= apps.size() || kind < 0 || kind >= APP_CALL_KIND_COUNT)
+    return std::nullopt;
+  std::scoped_lock lock(app_stats_mutex);
+  return apps[app_index].stats->calls[kind].summary();
+}
+
+void display_controller::flush_render_thread() {
+#ifdef RENDER_THREAD
+  std::unique_lock lock(render_mutex);
+  render_cv.wait(lock, [this] { return render_jobs.empty() && !render_busy; });
+#endif
+}
+
+#ifdef RENDER_THREAD
+void display_controller::render_thread_loop() {
+  std::unique_lock lock(render_mutex);
+  while (true) {
+    render_cv.wait(lock, [this] { return render_stop || !render_jobs.empty(); });
+    if (render_jobs.empty())
+      return;
+
+    render_job_t job = std::move(render_jobs.front());
+    render_jobs.pop_front();
+    render_busy = true;
+    lock.unlock();
+    job();
+    lock.lock();
+    render_busy = false;
+    render_cv.notify_all();
+  }
+}
+
+void display_controller::render_handoff_frame() {
+  {
+    std::scoped_lock lock(render_mutex);
+    std::swap(rendering_frame, handoff_frame);
+    handoff_pending = false;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  const auto damage = rasterize_frame(rendering_frame.as_array());
+  record_app_call(rendering_frame.owner, APP_CALL_RENDER, std::chrono::steady_clock::now() - start);
+  if (damage)
+    present(damage);
+}
+#endif
+
+static bool app_file_sort(const app_index_entry &a, const app_index_entry &b) {
+  return a.path.filename().string() < b.path.filename().string();
+}
+
+// Resident set size of this process
+static size_t resident_set_kb() {
+  std::ifstream statm("/proc/self/statm");
+  size_t size_pages = 0;
+  size_t resident_pages = 0;
+  if (!(statm >> size_pages >> resident_pages))
+    return 0;
+  return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE)) / 1024;
+}
+
+// MemAvailable from /proc/meminfo, missing on kernels older than 3.14
+static std::optional<size_t> available_memory_kb() {
+  std::ifstream meminfo("/proc/meminfo");
+  std::string key;
+  size_t value = 0;
+  while (meminfo >> key >> value) {
+    if (key == "MemAvailable:")
+      return value;
+    meminfo.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+  return std::nullopt;
 }
 
 void display_controller::load_apps() {
   assert(apps.empty() && "Apps have already been loaded");
 
-  register_app_loader(".so", load_app_shared_object);
+  register_app_loader(".so", load_app_shared_object, &so_app_handles);
 
   void *main_menu_userptr = nullptr;
-  apps.emplace_back(*register_main_menu_app(this, &main_menu_userptr), main_menu_userptr);
+  const app_descriptor *main_menu_descriptor = register_main_menu_app(this, &main_menu_userptr);
+  apps.push_back({ .name = main_menu_descriptor->name,
+                   .loaded = true,
+                   .descriptor = *main_menu_descriptor,
+                   .userptr = main_menu_userptr,
+                   .stats = get_app_stats("") });
+
+  for (const auto &file : scan_app_lookup_paths({}))
+    add_app(file);
+}
 
-  std::vector<fs::path> files;
+std::vector<app_index_entry> display_controller::scan_app_lookup_paths(const std::set<std::string> &changed_paths) {
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<app_index_entry> files;
   for (const auto &path : app_lookup_paths) {
     if (!fs::is_directory(path)) {
       std::cerr << "App lookup path is not a directory: " << path << std::endl;
       continue;
     }
-    for (const auto &entry : fs::directory_iterator(path)) {
-      const auto realpath = deref_symlink(entry.path());
-      if (!realpath.has_value() || !fs::is_regular_file(*realpath))
-        continue;
-      files.push_back(*realpath);
-    }
+    // Apps replaced in place don't invalidate the index
+    auto dir_files = scan_app_directory(path, !changed_paths.contains(path));
+    files.insert(files.end(), std::make_move_iterator(dir_files.begin()), std::make_move_iterator(dir_files.end()));
   }
 
   std::sort(files.begin(), files.end(), app_file_sort);
+  const std::chrono::duration<double, std::milli> scan_time = std::chrono::steady_clock::now() - start;
+  debugf("app index: %zu files in %zu lookup paths in %.1f ms\n",
+         files.size(),
+         app_lookup_paths.size(),
+         scan_time.count());
+  return files;
+}
+
+void display_controller::add_app(const app_index_entry &file) {
+  // Apps are loaded in order, so a manifest can't vouch for an extension a later app registers a loader for
+  if (!app_loaders.contains(file.extension)) {
+    std::cerr << "No app loader registered for extension: " << file.extension << std::endl;
+    return;
+  }
+
+  if (file.manifest.has_value() && !file.manifest->background) {
+    apps.push_back({ .name = file.manifest->name,
+                     .path = file.path.string(),
+                     .on_demand = true,
+                     .mtime = file.mtime,
+                     .size = file.size,
+                     .stats = get_app_stats(file.path.string()) });
+    debugf("Listed app: %s from %s\n", file.manifest->name.c_str(), file.path.c_str());
+    return;
+  }
+
+  app_entry app{ .path = file.path.string(),
+                 .mtime = file.mtime,
+                 .size = file.size,
+                 .stats = get_app_stats(file.path.string()) };
+  if (load_app(app))
+    apps.push_back(std::move(app));
+}
+
+bool display_controller::load_app(app_entry &app) {
+  if (app.loaded)
+    return true;
+
+  const auto it = app_loaders.find(fs::path(app.path).extension().string());
+  if (it == app_loaders.end()) {
+    std::cerr << "No app loader registered for app: " << app.path << std::endl;
+    return false;
+  }
+
+  const size_t resident_before_kb = resident_set_kb();
+  void *app_userptr = nullptr;
+  auto &[loader, loader_userptr] = it->second;
+  // Timers the app schedules while it's set up belong to it too, so they're canceled when it's unloaded
+  app_stats *outer = std::exchange(running_app, app.stats);
+  const app_descriptor *descriptor = loader(loader_userptr, this, app.path.c_str(), &app_userptr);
+  running_app = outer;
+  if (!descriptor) {
+    std::cerr << "Failed to load app: " << app.path << std::endl;
+    timers.cancel_owner(app.stats);
+    return false;
+  }
+  const size_t resident_after_kb = resident_set_kb();
+  app.resident_kb = resident_after_kb > resident_before_kb ? resident_after_kb - resident_before_kb : 0;
+
+  if (app.name.empty())
+    app.name = descriptor->name;
+  app.stats->budget_strikes = 0;
+  app.has_ui = descriptor->on_enter != nullptr;
+  app.loaded = true;
+  app.descriptor = *descriptor;
+  app.userptr = app_userptr;
+  std::cout << "Loaded app: " << descriptor->name << " from " << app.path << " (" << app.resident_kb << " KiB)"
+            << std::endl;
+  return true;
+}
+
+void display_controller::release_app(app_entry &app) {
+  if (!app.loaded)
+    return;
+  // Frames being rendered may still point at the app's images, which it frees in its teardown
+  flush_render_thread();
+  cancel_app_tasks(app);
+  // Their callbacks are in the app's code, a misbehaving app may not have canceled them when it was left
+  timers.cancel_owner(app.stats);
+  if (app.descriptor.on_teardown)
+    app.descriptor.on_teardown(app.userptr, this);
+  // The descriptor may point into the shared object
+  app.descriptor = {};
+  app.userptr = nullptr;
+  app.loaded = false;
+  app.resident_kb = 0;
+  unload_app_shared_object(&so_app_handles, app.path.c_str());
+  std::cout << "Unloaded app: " << app.name << std::endl;
+}
+
+void display_controller::unload_app(app_entry &app) {
+  assert(app.on_demand && app.loaded && "Only loaded on-demand apps can be unloaded");
+  release_app(app);
+}
 
-  for (const auto &file_path : files) {
-    const std::string ext = file_path.extension().string();
-    const auto it = app_loaders.find(ext);
-    if (it == app_loaders.end()) {
-      std::cerr << "No app loader registered for extension: " << ext << std::endl;
+void display_controller::reload_apps(const std::set<std::string> &changed_paths) {
+  if (changed_paths.empty())
+    return;
+  const auto files = scan_app_lookup_paths(changed_paths);
+  std::map<std::string, const app_index_entry *> files_by_path;
+  for (const auto &file : files)
+    files_by_path[file.path.string()] = &file;
+
+  const auto is_stale = [&files_by_path](const app_entry &app) {
+    const auto it = files_by_path.find(app.path);
+    if (it == files_by_path.end())
+      return true;
+    const app_index_entry &file = *it->second;
+    const bool on_demand = file.manifest.has_value() && !file.manifest->background;
+    return file.mtime != app.mtime || file.size != app.size || on_demand != app.on_demand ||
+           (on_demand && file.manifest->name != app.name);
+  };
+
+  // Shared objects loaded at startup may have registered the loaders of other apps, so they're only reloaded along with
+  // all the others. Apps run by those loaders are reloaded on their own.
+  bool reload_all = false;
+  std::vector<bool> stale(apps.size(), false);
+  for (size_t i = 1; i < apps.size(); ++i) {
+    stale[i] = is_stale(apps[i]);
+    reload_all |= stale[i] && !apps[i].on_demand && fs::path(apps[i].path).extension() == ".so";
+  }
+  if (reload_all)
+    std::fill(stale.begin() + 1, stale.end(), true);
+
+  const std::string active_path = active_app_index.has_value() ? apps[*active_app_index].path : "";
+  if (active_app_index.has_value() && stale[*active_app_index])
+    set_active_app(0);
+
+  // Torn down in reverse so apps go before the ones that loaded them
+  for (size_t i = apps.size() - 1; i > 0; --i) {
+    if (!stale[i])
       continue;
+    release_app(apps[i]);
+    apps.erase(apps.begin() + static_cast<ptrdiff_t>(i));
+  }
+  if (reload_all) {
+    app_loaders.clear();
+    register_app_loader(".so", load_app_shared_object, &so_app_handles);
+  }
+
+  std::set<std::string> known_paths;
+  for (const auto &app : apps)
+    known_paths.insert(app.path);
+  for (const auto &file : files) {
+    if (!known_paths.contains(file.path.string()))
+      add_app(file);
+  }
+
+  // Keep the menu in file order, and the active app active
+  std::stable_sort(apps.begin() + 1, apps.end(), [](const app_entry &a, const app_entry &b) {
+    return fs::path(a.path).filename().string() < fs::path(b.path).filename().string();
+  });
+  if (active_app_index.has_value()) {
+    const auto it = std::ranges::find(apps, active_path, &app_entry::path);
+    active_app_index = it != apps.end() ? static_cast<size_t>(it - apps.begin()) : 0;
+  }
+
+  std::cout << "Reloaded apps: " << apps.size() - 1 << " apps" << std::endl;
+  if (active_app_index == 0)
+    static_cast<main_menu_app *>(apps[0].userptr)->on_apps_changed(*this);
+}
+
+void display_controller::unload_idle_apps() {
+  bool idle_apps_loaded = false;
+  while (true) {
+    size_t idle_kb = 0;
+    app_entry *lru = nullptr;
+    for (size_t i = 0; i < apps.size(); ++i) {
+      app_entry &app = apps[i];
+      if (!app.on_demand || !app.loaded || i == active_app_index)
+        continue;
+      idle_kb += app.resident_kb;
+      if (!lru || app.last_entered < lru->last_entered)
+        lru = &app;
     }
+    if (!lru)
+      break;
 
-    void *app_userptr = nullptr;
-    auto &[loader, loader_userptr] = it->second;
-    app_descriptor *descriptor = loader(loader_userptr, this, file_path.string().c_str(), &app_userptr);
-    if (!descriptor) {
-      std::cerr << "Failed to load app: " << file_path << std::endl;
-      continue;
+    const bool over_budget = APP_MEMORY_BUDGET_KB > 0 && idle_kb > APP_MEMORY_BUDGET_KB;
+    const auto available_kb = available_memory_kb();
+    const bool low_memory = APP_LOW_MEMORY_KB > 0 && available_kb.has_value() && *available_kb < APP_LOW_MEMORY_KB;
+    if (!over_budget && !low_memory) {
+      idle_apps_loaded = true;
+      break;
     }
 
-    apps.emplace_back(*descriptor, app_userptr);
-    std::cout << "Loaded app: " << descriptor->name << " from " << file_path << std::endl;
+    debugf("unloading %s: %zu KiB used by idle apps, %zu KiB available\n",
+           lru->name.c_str(),
+           idle_kb,
+           available_kb.value_or(0));
+    unload_app(*lru);
+  }
+
+  // Loaded apps keep running in the background, and the rest of the system keeps allocating, so the limits are checked
+  // again until there's nothing left to unload. The check isn't urgent and can wait for another wakeup.
+  constexpr bool check_memory = APP_MEMORY_CHECK_MS > 0 && (APP_MEMORY_BUDGET_KB > 0 || APP_LOW_MEMORY_KB > 0);
+  if (check_memory && idle_apps_loaded && memory_check_timer_id == 0) {
+    memory_check_timer_id = schedule_timer([this] { post_event({ .type = event_type::unload_idle_apps }); },
+                                           APP_MEMORY_CHECK_MS,
+                                           true,
+                                           APP_MEMORY_CHECK_MS);
+  } else if (!idle_apps_loaded && memory_check_timer_id != 0) {
+    cancel_timer(memory_check_timer_id);
+    memory_check_timer_id = 0;
   }
 }
 
@@ -137,17 +828,36 @@ void display_controller::set_active_app(const std::optional<size_t> app_index) {
   assert(!app_index.has_value() || app_index.value() < apps.size());
   if (app_index == active_app_index)
     return;
+  if (app_index.has_value()) {
+    // Apps listed from their manifest are loaded the first time they're entered
+    auto &app = apps[app_index.value()];
+    if (!load_app(app) || !app.has_ui) {
+      std::cerr << "Cannot enter app: " << app.name << std::endl;
+      return;
+    }
+    app.last_entered = ++app_enter_count;
+  }
   if (active_app_index.has_value()) {
-    if (auto &[descriptor, userptr] = apps[active_app_index.value()]; descriptor.on_leave) {
-      descriptor.on_leave(userptr, this);
+    auto &app = apps[active_app_index.value()];
+    if (app.descriptor.on_leave) {
+      call_app(app.stats, APP_CALL_LEAVE, [&] { app.descriptor.on_leave(app.userptr, this); });
     }
+    // Their completions are delivered from the event loop, once the app is off the stack
+    tasks.cancel_owner(app.stats, false);
   }
   active_app_index = app_index;
+#ifdef FRAME_SCHEDULER
+  // A frame from the previous app may point at its images
+  drop_pending_frame();
+#endif
   if (active_app_index.has_value()) {
-    auto &[descriptor, userptr] = apps[active_app_index.value()];
-    assert(descriptor.on_enter != nullptr && "Active app must have on_enter callback");
-    descriptor.on_enter(userptr, this);
+    auto &app = apps[active_app_index.value()];
+    assert(app.descriptor.on_enter != nullptr && "Active app must have on_enter callback");
+    call_app(app.stats, APP_CALL_ENTER, [&] { app.descriptor.on_enter(app.userptr, this); });
   }
+
+  // The app we just left may be on the stack, so it can only be unloaded once we're back in the event loop
+  post_event({ .type = event_type::unload_idle_apps });
 }
 
 std::vector<std::string> display_controller::get_app_lookup_paths() {
@@ -179,19 +889,275 @@ std::vector<std::string> display_controller::get_app_lookup_paths() {
 }
 
 void display_controller::clay_render(const Clay_RenderCommandArray &cmds) {
+  // Clay keeps the state of every clip container it has seen, up to a fixed number, until scroll containers are
+  // updated. Screens scroll with explicit child offsets, but each menu entry clips its text.
+  Clay_UpdateScrollContainers(false, Clay_Vector2{ 0, 0 }, 0);
+
+  const uint64_t frame_hash = hash_render_commands(cmds);
+  if (last_frame_hash == frame_hash) {
+#ifdef FRAME_SCHEDULER
+    // Back to what's on screen, whatever was submitted in between is stale
+    drop_pending_frame();
+#endif
+    ++skipped_frames;
+    render_debugf("clay_render: frame unchanged, skipping\n");
+    return;
+  }
+
+#ifdef FRAME_SCHEDULER
+  submit_frame(cmds, frame_hash);
+#else
+  last_frame_hash = frame_hash;
+  const auto start = std::chrono::steady_clock::now();
+  const auto damage = rasterize_frame(cmds);
+  record_app_call(running_app, APP_CALL_RENDER, std::chrono::steady_clock::now() - start);
+  if (damage)
+    present(damage);
+#endif
+}
+
+#ifdef FRAME_SCHEDULER
+void display_controller::submit_frame(const Clay_RenderCommandArray &cmds, const uint64_t frame_hash) {
+  if (frame_pending) {
+    ++coalesced_frames;
+    render_debugf("clay_render: replacing frame pending for the next slot\n");
+  }
+
+  const std::span commands(cmds.internalArray, cmds.length);
+  size_t text_length = 0;
+  for (const Clay_RenderCommand &cmd : commands) {
+    if (cmd.commandType == CLAY_RENDER_COMMAND_TYPE_TEXT)
+      text_length += cmd.renderData.text.stringContents.length;
+  }
+
+  // Size the text buffer up front so the copied commands can point into it
+  pending_frame.commands.assign(commands.begin(), commands.end());
+  pending_frame.text.resize(text_length);
+  pending_frame.hash = frame_hash;
+  pending_frame.owner = running_app;
+  char *text = pending_frame.text.data();
+  for (Clay_RenderCommand &cmd : pending_frame.commands) {
+    if (cmd.commandType != CLAY_RENDER_COMMAND_TYPE_TEXT)
+      continue;
+    Clay_StringSlice &slice = cmd.renderData.text.stringContents;
+    std::copy_n(slice.chars, slice.length, text);
+    slice.chars = text;
+    slice.baseChars = text;
+    text += slice.length;
+  }
+  frame_pending = true;
+
+  if (frame_timer_id == 0) {
+    const auto now = std::chrono::steady_clock::now();
+    const auto slot = std::max(now, last_frame_slot + std::chrono::milliseconds(FRAME_INTERVAL_MS));
+    const auto delay_ms = std::chrono::ceil<std::chrono::milliseconds>(slot - now).count();
+    frame_timer_id = schedule_timer([this] { on_frame_slot(); }, static_cast<uint32_t>(delay_ms), false, 0);
+  }
+}
+
+void display_controller::on_frame_slot() {
+  frame_timer_id = 0;
+  if (!frame_pending)
+    return;
+
+  frame_pending = false;
+  last_frame_slot = std::chrono::steady_clock::now();
+  last_frame_hash = pending_frame.hash;
+#ifdef RENDER_THREAD
+  {
+    std::scoped_lock render_lock(render_mutex);
+    std::swap(handoff_frame, pending_frame);
+    // Still waiting for the render thread, which will pick up this frame instead
+    if (handoff_pending) {
+      ++coalesced_frames;
+      return;
+    }
+    handoff_pending = true;
+  }
+  on_render_thread([this] { render_handoff_frame(); });
+#else
+  const auto start = std::chrono::steady_clock::now();
+  const auto damage = rasterize_frame(pending_frame.as_array());
+  record_app_call(pending_frame.owner, APP_CALL_RENDER, std::chrono::steady_clock::now() - start);
+  if (damage)
+    present(damage);
+#endif
+}
+
+void display_controller::drop_pending_frame() {
+  if (frame_pending)
+    ++coalesced_frames;
+  frame_pending = false;
+}
+#endif
+
+std::optional<IntRect> display_controller::rasterize_frame(const Clay_RenderCommandArray &cmds) {
+  const IntRect bounds{ 0, 0, width(), height() };
+  const FrameDamage damage = damage_tracker.update(cmds, font_registry, bounds);
+  if (damage.empty()) {
+    ++skipped_frames;
+    render_debugf("clay_render: no damage, skipping\n");
+    return std::nullopt;
+  }
+  if (damage.scroll) {
+    [[maybe_unused]] const auto &[rect, dy] = *damage.scroll;
+    render_debugf("clay_render: scroll [%d, %d, %d, %d] by %d\n", rect.x, rect.y, rect.w, rect.h, dy);
+    ++scrolled_frames;
+  }
+  for (const IntRect &rect : damage.rects) {
+    render_debugf("clay_render: damage [%d, %d, %d, %d]\n", rect.x, rect.y, rect.w, rect.h);
+    damaged_pixels += static_cast<uint64_t>(rect.w) * rect.h;
+  }
+  rendered_pixels += static_cast<uint64_t>(bounds.w) * bounds.h;
+
+  TextRunCache *text_cache = text_run_cache.getBudget() > 0 ? &text_run_cache : nullptr;
+  auto repaint = [&](auto &renderer, const auto &background) {
+    if (damage.scroll)
+      renderer.scroll(damage.scroll->rect, damage.scroll->dy);
+    for (const IntRect &rect : damage.rects) {
+      renderer.clear(background, rect);
+      renderer.render(cmds, &rect);
+    }
+  };
   if (is_small_screen_mode) {
-    ClayBW1Renderer renderer(secret_screen_buf, font_registry);
-    renderer.clear(false);
-    renderer.render(cmds);
+    ClayBW1Renderer renderer(secret_screen_buf, font_registry, text_cache);
+    repaint(renderer, false);
   } else {
-    ClayBGR565Renderer renderer(secret_screen_buf, font_registry);
-    renderer.clear(Clay_Color{ 0, 0, 0, 255 });
-    renderer.render(cmds);
+    ClayBGR565Renderer renderer(secret_screen_buf, font_registry, text_cache);
+    repaint(renderer, Clay_Color{ 0, 0, 0, 255 });
+  }
+
+  return damage.bounds();
+}
+
+void display_controller::present(std::optional<IntRect> bounds) {
+  if (batching_refresh) {
+    if (refresh_pending) {
+      ++coalesced_refreshes;
+      if (bounds && pending_refresh_bounds)
+        pending_refresh_bounds = bounding_union(*pending_refresh_bounds, *bounds);
+      else
+        pending_refresh_bounds = std::nullopt;
+    } else {
+      pending_refresh_bounds = bounds;
+    }
+    refresh_pending = true;
+    return;
   }
+
+  uint16_t *overlay_rows = nullptr;
+  if (overlay) {
+    overlay_rows = secret_screen_buf + overlay->first_row * row_words();
+    overlay->backing.assign(overlay_rows, overlay_rows + overlay->pixels.size());
+    std::ranges::copy(overlay->pixels, overlay_rows);
+    if (bounds) {
+      const int rows = static_cast<int>(overlay->pixels.size() / row_words());
+      bounds = bounding_union(*bounds, IntRect{ 0, static_cast<int>(overlay->first_row), width(), rows });
+    }
+  }
+
+#ifdef PARTIAL_LCD_REFRESH
+  // The buffer always holds the full frame, the refresh bounds only tell the host which part of it changed
+  if (bounds && !is_small_screen_mode) {
+    const lcd_screen full_screen = secret_screen;
+    secret_screen.sx += bounds->x;
+    secret_screen.sy += bounds->y;
+    secret_screen.width = bounds->w;
+    secret_screen.height = bounds->h;
+    lcd_refresh_screen(&secret_screen);
+    secret_screen = full_screen;
+  } else {
+    lcd_refresh_screen(&secret_screen);
+  }
+#else
   lcd_refresh_screen(&secret_screen);
+#endif
+
+  if (overlay_rows)
+    std::ranges::copy(overlay->backing, overlay_rows);
 }
 
-std::optional<uint16_t> display_controller::get_font(const std::string &fontName, int fontSize) const {
+void display_controller::rasterize_overlay() {
+  constexpr int TOAST_PADDING = 2;
+  constexpr Clay_Color TOAST_BACKGROUND = { 0, 0, 0, 255 };
+  constexpr Clay_Color TOAST_FOREGROUND = { 255, 255, 255, 255 };
+
+  const uint16_t font_id = get_font(fonts::Poppins_8.name, fonts::Poppins_8.size).value_or(0);
+  // Not measure_text, its cache belongs to the app thread
+  const auto [text_width, text_height] = font_registry[font_id]->measure(overlay->text);
+  const int rows = std::min(text_height + 2 * TOAST_PADDING + 1, static_cast<int>(height()));
+  overlay->first_row = height() - rows;
+
+  const Clay_BoundingBox band{
+    0, static_cast<float>(overlay->first_row), static_cast<float>(width()), static_cast<float>(rows)
+  };
+  Clay_RenderCommand cmds[] = {
+    { .boundingBox = band,
+      .renderData = { .rectangle = { .backgroundColor = TOAST_BACKGROUND } },
+      .commandType = CLAY_RENDER_COMMAND_TYPE_RECTANGLE },
+    { .boundingBox = band,
+      .renderData = { .border = { .color = TOAST_FOREGROUND, .width = { .top = 1 } } },
+      .commandType = CLAY_RENDER_COMMAND_TYPE_BORDER },
+    { .boundingBox = { static_cast<float>(std::max(0, (width() - text_width) / 2)),
+                       static_cast<float>(overlay->first_row + 1 + TOAST_PADDING),
+                       static_cast<float>(text_width),
+                       static_cast<float>(text_height) },
+      .renderData = { .text = { .stringContents = { static_cast<int32_t>(overlay->text.size()),
+                                                    overlay->text.data(),
+                                                    overlay->text.data() },
+                                .textColor = TOAST_FOREGROUND,
+                                .fontId = font_id,
+                                .fontSize = fonts::Poppins_8.size } },
+      .commandType = CLAY_RENDER_COMMAND_TYPE_TEXT },
+  };
+  const Clay_RenderCommandArray cmd_array{ std::size(cmds), std::size(cmds), cmds };
+
+  // Render into a scratch framebuffer and keep only the overlay's rows
+  std::vector<uint16_t> scratch(std::size(secret_screen_buf));
+  TextRunCache *text_cache = text_run_cache.getBudget() > 0 ? &text_run_cache : nullptr;
+  if (is_small_screen_mode) {
+    ClayBW1Renderer(scratch.data(), font_registry, text_cache).render(cmd_array);
+  } else {
+    ClayBGR565Renderer(scratch.data(), font_registry, text_cache).render(cmd_array);
+  }
+  const auto first = scratch.begin() + static_cast<std::ptrdiff_t>(overlay->first_row * row_words());
+  overlay->pixels.assign(first, first + static_cast<std::ptrdiff_t>(rows * row_words()));
+}
+
+void display_controller::show_toast(const std::string &text, const uint32_t duration_ms) {
+  if (toast_timer_id)
+    cancel_timer(toast_timer_id);
+  toast_timer_id = 0;
+
+  on_render_thread([this, text = std::string(text)] {
+    overlay = overlay_state{ .text = text };
+    rasterize_overlay();
+    present();
+  });
+  if (duration_ms > 0) {
+    toast_timer_id = schedule_timer(
+      [this] {
+        toast_timer_id = 0;
+        hide_toast();
+      },
+      duration_ms);
+  }
+}
+
+void display_controller::hide_toast() {
+  if (toast_timer_id)
+    cancel_timer(toast_timer_id);
+  toast_timer_id = 0;
+
+  on_render_thread([this] {
+    if (!overlay)
+      return;
+    overlay.reset();
+    present();
+  });
+}
+
+std::optional<uint16_t> display_controller::get_font(const std::string_view fontName, const int fontSize) const {
   for (uint16_t i = 0; i < font_registry.size(); ++i) {
     const auto &font = font_registry[i];
     if (font->name == fontName && font->size == fontSize)
@@ -220,52 +1186,89 @@ void display_controller::bump_wake_state() {
   manage_heartbeat_timer(true);
 }
 
-uint32_t (*timer_delete_ex_orig)(uint32_t) = nullptr;
+void display_controller::manage_heartbeat_timer(const bool enable) {
+  debugf("display_controller::manage_heartbeat_timer: %s heartbeat timer\n", enable ? "enabling" : "disabling");
+  heartbeat_enabled = enable;
+  // Host timers that are already armed fire once more and find the heartbeat disabled
+  if (enable)
+    arm_heartbeat_timer();
+}
 
-void display_controller::cancel_heartbeat_timer_callback(void *userptr) {
-  const uint32_t timer_id = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(userptr));
-  debugf("display_controller::cancel_heartbeat_timer_callback: cancelling heartbeat timer id=%u\n", timer_id);
-  if (timer_delete_ex_orig == nullptr) {
-    timer_delete_ex_orig = reinterpret_cast<uint32_t (*)(uint32_t)>(dlsym(RTLD_DEFAULT, "osa_timer_delete_ex"));
-    assert(timer_delete_ex_orig != nullptr && "Failed to locate osa_timer_delete_ex");
-  }
-  timer_delete_ex_orig(timer_id);
+std::optional<std::chrono::steady_clock::time_point> display_controller::next_heartbeat_deadline() const {
+  std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt;
+  if (current_wake_state > WAKE_STATE_SLEEP)
+    deadline = next_wake_state_due;
+
+  if (const auto timer_deadline = timers.next_deadline(); timer_deadline && (!deadline || *timer_deadline < *deadline))
+    deadline = timer_deadline;
+  return deadline;
 }
 
-void display_controller::manage_heartbeat_timer(const bool enable) {
-  if (enable) {
-    debugf("display_controller::manage_heartbeat_timer: requested to enable heartbeat timer\n");
-    if (!heartbeat_timer_helper.has_value()) {
-      debugf("display_controller::manage_heartbeat_timer: enabling heartbeat timer\n");
-      std::scoped_lock lock(timer_mutex);
-      heartbeat_timer_helper.emplace([this] { on_heartbeat_timer(); }, 0, true, 0);
-
-      const uint32_t heartbeat_timer_id = timer_create_ex(FRAME_INTERVAL_MS,
-                                                          true,
-                                                          timer_helper::get_trampoline(),
-                                                          heartbeat_timer_helper->get_userptr());
-      heartbeat_timer_helper->set_timer_id(heartbeat_timer_id);
-    }
-  } else {
-    debugf("display_controller::manage_heartbeat_timer: requested to disable heartbeat timer\n");
-    if (heartbeat_timer_helper.has_value()) {
-      debugf("display_controller::manage_heartbeat_timer: disabling heartbeat timer\n");
-      timer_create_ex(0,
-                      false,
-                      cancel_heartbeat_timer_callback,
-                      reinterpret_cast<void *>(static_cast<uintptr_t>(heartbeat_timer_helper->get_timer_id())));
-      heartbeat_timer_helper = std::nullopt;
-    }
-  }
+void display_controller::arm_heartbeat_timer() {
+  if (!heartbeat_enabled || in_heartbeat)
+    return;
+
+  const auto deadline = next_heartbeat_deadline();
+  if (!deadline)
+    return;
+  // A host timer firing no later than the deadline re-arms from there
+  if (!armed_heartbeats.empty() && armed_heartbeats.front() <= *deadline)
+    return;
+
+  const auto now = std::chrono::steady_clock::now();
+  const auto delay_ms = *deadline > now ? std::chrono::ceil<std::chrono::milliseconds>(*deadline - now).count() : 0;
+  timer_create_ex(static_cast<uint32_t>(delay_ms),
+                  false,
+                  timer_helper::get_trampoline(),
+                  heartbeat_timer_helper.get_userptr());
+  armed_heartbeats.insert(armed_heartbeats.begin(), *deadline);
+  timer_debugf("armed heartbeat timer: delay_ms=%lld, pending=%zu\n",
+               static_cast<long long>(delay_ms),
+               armed_heartbeats.size());
 }
 
 void display_controller::set_active(const bool active) {
+  host_active = active;
   if (active == is_active)
     return;
 
+  // The panel shows the stock UI while we're inactive, so the next frame must always be drawn
+  invalidate_frame();
+
   if (!active) {
     set_active_app(std::nullopt);
     manage_heartbeat_timer(false);
+
+    // Toasts belong to the session that showed them
+    if (toast_timer_id)
+      cancel_timer(toast_timer_id);
+    toast_timer_id = 0;
+    on_render_thread([this] { overlay.reset(); });
+    // Nothing may be drawn once the stock UI has the screen back
+    flush_render_thread();
+
+    [[maybe_unused]] const auto stats = text_run_cache.stats();
+    debugf("text run cache: %u hits, %u misses, %u evictions, %zu entries, %zu/%zu bytes\n",
+           stats.hits,
+           stats.misses,
+           stats.evictions,
+           stats.entries,
+           stats.bytes,
+           text_run_cache.getBudget());
+    const auto measure_stats = text_measure_cache.stats();
+    [[maybe_unused]] const uint32_t measure_total = measure_stats.hits + measure_stats.misses;
+    debugf("text measure cache: %u hits, %u misses (%.1f%% hit rate)\n",
+           measure_stats.hits,
+           measure_stats.misses,
+           measure_total ? 100.0 * measure_stats.hits / measure_total : 0.0);
+#ifdef FRAME_SCHEDULER
+    debugf("frame scheduler: %u frames replaced before their slot\n", coalesced_frames);
+#endif
+    debugf("heartbeat: %u host timer wakeups, %u screen refreshes coalesced\n", heartbeat_wakeups, coalesced_refreshes);
+    debugf("clay_render: %u unchanged frames skipped, %u frames scrolled, %.1f%% of rendered pixels damaged\n",
+           skipped_frames.load(),
+           scrolled_frames,
+           rendered_pixels ? 100.0 * static_cast<double>(damaged_pixels) / static_cast<double>(rendered_pixels) : 0.0);
   } else {
     set_active_app(0);
 
@@ -277,9 +1280,9 @@ void display_controller::set_active(const bool active) {
   schedule_timer(
     [this] {
       if (is_active && active_app_index.has_value()) {
-        auto &[descriptor, userptr] = apps[active_app_index.value()];
-        if (descriptor.on_enter) {
-          descriptor.on_enter(userptr, this);
+        auto &app = apps[active_app_index.value()];
+        if (app.descriptor.on_enter) {
+          call_app(app.stats, APP_CALL_ENTER, [&] { app.descriptor.on_enter(app.userptr, this); });
         }
       }
     },
@@ -292,7 +1295,13 @@ void display_controller::switch_to_small_screen_mode() {
   if (is_small_screen_mode)
     return;
 
+  // The render thread reads the display mode and the screen descriptor
+  flush_render_thread();
   is_small_screen_mode = true;
+  invalidate_frame();
+#ifdef FRAME_SCHEDULER
+  drop_pending_frame();
+#endif
   secret_screen = { .sx = 0,
                     .height = height(),
                     .sy = 0,
@@ -301,22 +1310,27 @@ void display_controller::switch_to_small_screen_mode() {
                     .buf = secret_screen_buf };
 
   Clay_SetLayoutDimensions(Clay_Dimensions{ 128, 64 });
+
+  on_render_thread([this] {
+    if (overlay)
+      rasterize_overlay();
+  });
 }
 
 void display_controller::on_keypress(const int button) {
   if (current_wake_state == WAKE_STATE_SLEEP) {
     bump_wake_state();
     if (active_app_index.has_value()) {
-      if (auto &[descriptor, userptr] = apps[active_app_index.value()]; descriptor.on_enter) {
-        descriptor.on_enter(userptr, this);
+      if (auto &app = apps[active_app_index.value()]; app.descriptor.on_enter) {
+        call_app(app.stats, APP_CALL_ENTER, [&] { app.descriptor.on_enter(app.userptr, this); });
       }
     }
     return;
   }
   bump_wake_state();
   if (active_app_index.has_value()) {
-    if (auto &[descriptor, userptr] = apps[active_app_index.value()]; descriptor.on_keypress) {
-      descriptor.on_keypress(userptr, this, button);
+    if (auto &app = apps[active_app_index.value()]; app.descriptor.on_keypress) {
+      call_app(app.stats, APP_CALL_KEYPRESS, [&] { app.descriptor.on_keypress(app.userptr, this, button); });
     }
   }
 }
@@ -331,48 +1345,45 @@ void display_controller::fatal_error(const char *message, const bool unload_app)
   app_error_message = message;
   const auto prev_active_index = active_app_index;
   goto_main_menu();
+  // The app is usually still on the stack, reporting its own error, so it's unloaded from the event loop. Its timers
+  // are canceled right away, they'd otherwise keep firing until then.
   if (unload_app && prev_active_index.has_value() && prev_active_index.value() != 0) {
-    if (auto &[descriptor, userptr] = apps[prev_active_index.value()]; descriptor.on_teardown) {
-      descriptor.on_teardown(userptr, this);
-    }
-    apps.erase(apps.begin() + static_cast<ptrdiff_t>(*prev_active_index));
+    timers.cancel_owner(apps[*prev_active_index].stats);
+    post_event({ .type = event_type::remove_app, .app = apps[*prev_active_index].stats });
   }
 }
 
 void display_controller::on_heartbeat_timer() {
-  std::scoped_lock lock(timer_mutex);
   timer_debugf("display_controller::on_heartbeat_timer\n");
+  // Host timers fire in deadline order, so these are always the earliest ones
+  const uint32_t fires = heartbeat_fires.exchange(0, std::memory_order_relaxed);
+  armed_heartbeats.erase(armed_heartbeats.begin(),
+                         armed_heartbeats.begin() + std::min<std::ptrdiff_t>(fires, std::ssize(armed_heartbeats)));
+  if (!heartbeat_enabled)
+    return;
+  ++heartbeat_wakeups;
+  in_heartbeat = true;
   const auto now = std::chrono::steady_clock::now();
+  const auto run_timer = [this](void *owner, timer_queue::callback_t &callback) {
+    if (owner)
+      call_app(static_cast<app_stats *>(owner), APP_CALL_TIMER, callback);
+    else
+      callback();
+  };
 
-  for (auto it = active_timers.begin(); it != active_timers.end();) {
-    if (it->is_marked_for_deletion()) {
-      it = active_timers.erase(it);
-      continue;
-    }
-
-    if (now >= it->get_expiration()) {
-      try {
-        (*it)();
-      } catch (...) {
-        std::cerr << "Exception in timer callback\n";
-      }
-
-      // Check if it was marked for deletion during callback
-      if (it->is_marked_for_deletion()) {
-        it = active_timers.erase(it);
-        continue;
-      }
-
-      if (it->is_repeat()) {
-        it->set_expiration(now + std::chrono::milliseconds(it->get_interval_ms()));
-        ++it;
-      } else {
-        it = active_timers.erase(it);
-      }
-    } else {
-      ++it;
-    }
+#ifdef RENDER_THREAD
+  // Refreshes happen on the render thread, once per frame slot
+  timers.run_expired(now, FRAME_INTERVAL_MS, TIMER_SLACK_MS[current_wake_state], run_timer);
+#else
+  // Frames rendered by the timers that are due together go to the screen once
+  batching_refresh = true;
+  timers.run_expired(now, FRAME_INTERVAL_MS, TIMER_SLACK_MS[current_wake_state], run_timer);
+  batching_refresh = false;
+  if (refresh_pending) {
+    refresh_pending = false;
+    present(pending_refresh_bounds);
   }
+#endif
 
   // Handle wake state timeout
   if (now >= next_wake_state_due) {
@@ -382,9 +1393,10 @@ void display_controller::on_heartbeat_timer() {
 
       wake_state_t min_wake_state = WAKE_STATE_SLEEP;
       if (active_app_index.has_value()) {
-        auto &[descriptor, userptr] = apps[active_app_index.value()];
-        if (descriptor.get_minimum_wake_state) {
-          const wake_state_t app_min_wake_state = descriptor.get_minimum_wake_state(userptr, this);
+        auto &app = apps[active_app_index.value()];
+        if (app.descriptor.get_minimum_wake_state) {
+          const wake_state_t app_min_wake_state = call_app(
+            app.stats, APP_CALL_WAKE_STATE, [&] { return app.descriptor.get_minimum_wake_state(app.userptr, this); });
           if (app_min_wake_state < min_wake_state) {
             min_wake_state = app_min_wake_state;
           }
@@ -404,35 +1416,47 @@ void display_controller::on_heartbeat_timer() {
       }
     }
   }
-}
 
-uint32_t display_controller::schedule_timer(std::function<void()> &&callback, uint32_t interval_ms, bool repeat) {
-  std::scoped_lock lock(timer_mutex);
+  in_heartbeat = false;
+  arm_heartbeat_timer();
+}
 
-  uint32_t id = next_timer_id++;
-  active_timers.emplace_back(std::move(callback), id, repeat, interval_ms);
+uint32_t display_controller::schedule_timer(timer_queue::callback_t &&callback,
+                                            const uint32_t interval_ms,
+                                            const bool repeat,
+                                            const std::optional<uint32_t> slack_ms,
+                                            app_stats *owner) {
+  const uint32_t id = timers.schedule(std::move(callback),
+                                      std::chrono::steady_clock::now() + std::chrono::milliseconds(interval_ms),
+                                      interval_ms,
+                                      repeat,
+                                      slack_ms,
+                                      TIMER_SLACK_MS[current_wake_state],
+                                      owner);
 
-  timer_debugf("scheduled internal timer: id=%u, interval_ms=%u, repeat=%d\n", id, interval_ms, repeat);
+  timer_debugf("scheduled internal timer: id=%u, interval_ms=%u, repeat=%d, slack_ms=%d\n",
+               id,
+               interval_ms,
+               repeat,
+               slack_ms ? static_cast<int>(*slack_ms) : -1);
+  arm_heartbeat_timer();
   return id;
 }
 
 uint32_t display_controller::schedule_timer(void (*callback)(void *userptr),
                                             const uint32_t interval_ms,
                                             const bool repeat,
-                                            void *userptr) {
-  // Always use std::function timers so we can handle nested timer cancellations
-  return schedule_timer([userptr, callback] { callback(userptr); }, interval_ms, repeat);
+                                            void *userptr,
+                                            const std::optional<uint32_t> slack_ms,
+                                            app_stats *owner) {
+  return schedule_timer([userptr, callback] { callback(userptr); }, interval_ms, repeat, slack_ms, owner);
 }
 
 uint32_t display_controller::cancel_timer(const uint32_t timer_id) {
-  std::scoped_lock lock(timer_mutex);
-
-  for (auto &timer : active_timers) {
-    if (timer.get_timer_id() == timer_id) {
-      timer.mark_for_deletion();
-      timer_debugf("canceled internal timer: id=%u\n", timer_id);
-      return 0;
-    }
+  // A pending host timer for a canceled deadline just finds nothing due
+  if (timers.cancel(timer_id)) {
+    timer_debugf("canceled internal timer: id=%u\n", timer_id);
+    return 0;
   }
 
   return 1;
@@ -1,8 +1,10 @@
 #include <cassert>
+#include <csignal>
 #include <cstdarg>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <dlfcn.h>
 #include <iostream>
 #include <sys/capability.h>
@@ -11,6 +13,7 @@
 
 #include "display_controller.hpp"
 #include "hooked_functions.h"
+#include "signal_chain.hpp"
 
 #define HIJACK extern "C" __attribute__((visibility("default"), noinline))
 
@@ -20,6 +23,14 @@ int (*notify_handler_async_real)(int subsystemid, int action, int subaction) = n
 void (*lcd_refresh_screen_real)(const lcd_screen *screen) = nullptr;
 int (*lcd_control_operate_real)(int lcd_mode) = nullptr;
 
+static struct sigaction host_sigusr2_action{};
+
+// `kill -USR2` prints how long each app spends in its callbacks
+static void on_sigusr2(const int sig, siginfo_t *info, void *context) {
+  screen_controller->request_app_stats_dump();
+  chain_signal_handler(host_sigusr2_action, sig, info, context);
+}
+
 HIJACK int lcd_control_operate(const int lcd_mode) {
   assert(screen_controller != nullptr && "Screen controller is null");
   // we use other values in secret mode to have full control on lcd
@@ -43,9 +54,9 @@ HIJACK void lcd_refresh_screen(const lcd_screen *screen) {
   if (screen_controller->active() && !screen_controller->is_own_screen(screen)) {
     return;
   }
-  // Detect and report small display devices
-  if (!screen_controller->active() && screen && screen->buf_len == 1024) {
-    screen_controller->switch_to_small_screen_mode();
+  // Detect and report small display devices, once: every refresh would otherwise queue an event
+  if (!screen_controller->active() && screen && screen->buf_len == 1024 && !screen_controller->is_small_screen()) {
+    screen_controller->post_small_screen_detected();
   }
   // If everything's good, actually perform the refresh
   lcd_refresh_screen_real(screen);
@@ -60,7 +71,7 @@ int notify_handler_async(int subsystemid, int action, int subaction) {
 
   if (subsystemid == SUBSYSTEM_GPIO) {
     if (action == BUTTON_LONGMENU) {
-      screen_controller->set_active(!screen_controller->active());
+      screen_controller->post_toggle_active();
       // force restarting the LED brightness timer if already fired
       if (!screen_controller->is_small_screen()) {
         notify_handler_async_real(SUBSYSTEM_GPIO, BUTTON_POWER, 0);
@@ -72,7 +83,7 @@ int notify_handler_async(int subsystemid, int action, int subaction) {
     }
 
     if (screen_controller->active() && (action == BUTTON_MENU || action == BUTTON_POWER)) {
-      screen_controller->on_keypress(action);
+      screen_controller->post_keypress(action);
       return 0;
     }
   }
@@ -88,6 +99,8 @@ register_notify_handler(int subsystemid, void *notify_handler_sync, notify_handl
   if (screen_controller == nullptr) {
     std::cout << "Initializing display controller" << std::endl;
     screen_controller = std::make_unique<display_controller>();
+    if (!install_signal_handler(SIGUSR2, on_sigusr2, host_sigusr2_action))
+      std::cerr << "Failed to install the SIGUSR2 handler: " << strerror(errno) << std::endl;
   }
 
   static int (*register_notify_handler_real)(int, void *, void *) = nullptr;
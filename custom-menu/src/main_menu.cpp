@@ -20,20 +20,28 @@ void main_menu_app::load_app_actions(display_controller &controller) {
   }));
 
   int index = 0;
-  for (const auto &kv : controller.get_apps()) {
+  for (const auto &app : controller.get_apps()) {
     const auto cur_index = index++;
-    const auto &[descriptor, _] = kv;
     if (cur_index == 0)
       continue; // skip main menu itself
-    if (descriptor.on_enter == nullptr)
+    if (!app.has_ui)
       continue; // skip apps without GUI
-    actions.emplace_back(std::make_unique<ui::actions::button>(descriptor.name, [&controller, cur_index] {
+    actions.emplace_back(std::make_unique<ui::actions::button>(app.name, [&controller, cur_index] {
       controller.set_active_app(cur_index);
     }));
   }
+  // The app names may have changed even if there are as many as before
+  menu_screen->invalidate_layout();
   debugf("registered %zu main menu actions\n", actions.size());
 }
 
+void main_menu_app::on_apps_changed(display_controller &controller) {
+  const size_t active_entry = menu_screen->get_active_entry();
+  load_app_actions(controller);
+  menu_screen->set_active_entry(std::min(active_entry, actions.size() - 1));
+  session.render();
+}
+
 void main_menu_app::on_enter(const app_api_t controller_api) {
   assert(controller_api != nullptr);
   auto &controller = static_cast<display_controller &>(*controller_api);
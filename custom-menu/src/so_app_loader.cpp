@@ -1,11 +1,14 @@
 #include <dlfcn.h>
 #include <iostream>
+#include <map>
 #include <ostream>
+#include <string>
 
 #include "display_controller.hpp"
 #include "so_app_loader.hpp"
 
-app_descriptor *load_app_shared_object(void *, app_api_t controller_api, const char *app_path, void **app_userptr) {
+app_descriptor *
+load_app_shared_object(void *userptr, app_api_t controller_api, const char *app_path, void **app_userptr) {
   void *handle = dlopen(app_path, RTLD_NOW | RTLD_LOCAL);
   if (!handle) {
     std::cerr << "Failed to load app shared object: " << dlerror() << std::endl;
@@ -27,5 +30,16 @@ app_descriptor *load_app_shared_object(void *, app_api_t controller_api, const c
     return nullptr;
   }
 
+  (*static_cast<std::map<std::string, void *> *>(userptr))[app_path] = handle;
   return descriptor;
 }
+
+void unload_app_shared_object(void *userptr, const char *app_path) {
+  auto &handles = *static_cast<std::map<std::string, void *> *>(userptr);
+  const auto it = handles.find(app_path);
+  if (it == handles.end())
+    return;
+  if (dlclose(it->second) != 0)
+    std::cerr << "Failed to close app shared object: " << dlerror() << std::endl;
+  handles.erase(it);
+}
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <iostream>
+
+#include "task_pool.hpp"
+
+task_pool::task_pool(const uint32_t max_workers,
+                     const uint32_t capacity,
+                     const uint32_t max_per_owner,
+                     std::function<void()> on_finished)
+    : max_workers(max_workers), capacity(capacity), max_per_owner(max_per_owner), on_finished(std::move(on_finished)) {
+}
+
+task_pool::~task_pool() {
+  stop();
+}
+
+void task_pool::worker_loop() {
+  std::unique_lock lock(mutex);
+  while (true) {
+    ++idle_workers;
+    work_cv.wait(lock, [this] { return stopping || !queue.empty(); });
+    --idle_workers;
+    if (stopping)
+      return;
+
+    queued_task task = std::move(queue.front());
+    queue.pop_front();
+    running.push_back({ .id = task.id, .owner = task.owner, .canceled = false });
+    lock.unlock();
+
+    try {
+      task.task();
+    } catch (...) {
+      std::cerr << "Exception in background task\n";
+    }
+    // Whatever the task captured goes away here, not on the thread running the completion
+    task.task = nullptr;
+
+    lock.lock();
+    const auto it = std::ranges::find(running, task.id, &running_task::id);
+    finished.push_back({ .owner = task.owner, .done = std::move(task.done), .canceled = it->canceled });
+    running.erase(it);
+    release_in_flight(task.owner);
+    idle_cv.notify_all();
+    lock.unlock();
+    on_finished();
+    lock.lock();
+  }
+}
+
+void task_pool::release_in_flight(void *owner) {
+  if (const auto it = in_flight.find(owner); it != in_flight.end() && --it->second == 0)
+    in_flight.erase(it);
+}
+
+uint32_t task_pool::post(void *owner, task_t &&task, done_t &&done) {
+  std::scoped_lock lock(mutex);
+  if (max_workers == 0 || stopping)
+    return 0;
+  if (queue.size() >= capacity) {
+    std::cerr << "Background task queue full, dropping task\n";
+    return 0;
+  }
+  uint32_t &owner_tasks = in_flight[owner];
+  if (owner_tasks >= max_per_owner) {
+    std::cerr << "Too many background tasks in flight, dropping task\n";
+    return 0;
+  }
+  ++owner_tasks;
+
+  const uint32_t id = next_id++;
+  if (next_id == 0)
+    next_id = 1;
+  queue.push_back({ .id = id, .owner = owner, .task = std::move(task), .done = std::move(done) });
+  // Idle workers are already waiting for this task, unless they've all been claimed by earlier ones
+  if (idle_workers < queue.size() && workers.size() < max_workers)
+    workers.emplace_back([this] { worker_loop(); });
+  work_cv.notify_one();
+  return id;
+}
+
+bool task_pool::cancel(const uint32_t task_id) {
+  {
+    std::scoped_lock lock(mutex);
+    if (const auto it = std::ranges::find(running, task_id, &running_task::id); it != running.end()) {
+      const bool was_canceled = it->canceled;
+      it->canceled = true;
+      return !was_canceled;
+    }
+    const auto it = std::ranges::find(queue, task_id, &queued_task::id);
+    if (it == queue.end())
+      return false;
+    finished.push_back({ .owner = it->owner, .done = std::move(it->done), .canceled = true });
+    release_in_flight(it->owner);
+    queue.erase(it);
+  }
+  on_finished();
+  return true;
+}
+
+void task_pool::cancel_owner(void *owner, const bool wait) {
+  bool dropped = false;
+  {
+    std::unique_lock lock(mutex);
+    for (auto it = queue.begin(); it != queue.end();) {
+      if (it->owner != owner) {
+        ++it;
+        continue;
+      }
+      finished.push_back({ .owner = owner, .done = std::move(it->done), .canceled = true });
+      release_in_flight(owner);
+      it = queue.erase(it);
+      dropped = true;
+    }
+
+    const auto owns = [owner](const running_task &task) { return task.owner == owner; };
+    for (auto &task : running) {
+      if (owns(task))
+        task.canceled = true;
+    }
+    if (wait)
+      idle_cv.wait(lock, [&] { return std::ranges::none_of(running, owns); });
+  }
+  if (dropped)
+    on_finished();
+}
+
+void task_pool::stop() {
+  {
+    std::scoped_lock lock(mutex);
+    stopping = true;
+    queue.clear();
+  }
+  work_cv.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+  workers.clear();
+}
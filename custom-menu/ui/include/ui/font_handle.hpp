@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+#include "apps/app_api.hpp"
+
+namespace ui {
+
+/**
+ * Font ID resolved once by name and size and cached until the controller's font registry generation changes.
+ */
+class font_handle {
+  const char *name;
+  int size;
+  uint16_t id = 0;
+  uint32_t generation = 0;
+  bool resolved = false;
+
+public:
+  constexpr font_handle(const char *name, const int size) : name(name), size(size) {}
+
+  /**
+   * Get the font ID, resolving it again only if fonts were added since the last lookup. Falls back to font 0 if the
+   * font isn't registered.
+   *
+   * @param controller_api The controller API object
+   * @return The font ID
+   */
+  uint16_t get(const display_controller_api &controller_api) {
+    const uint32_t current_generation = controller_api.get_font_generation();
+    if (!resolved || generation != current_generation) {
+      id = controller_api.get_font(name, size).value_or(0);
+      generation = current_generation;
+      resolved = true;
+    }
+    return id;
+  }
+};
+
+} // namespace ui
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <limits>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "clay.hpp"
@@ -13,6 +16,7 @@
 #include "ui/actions/page_break.hpp"
 #include "ui/actions/radio.hpp"
 #include "ui/actions/toggle.hpp"
+#include "ui/font_handle.hpp"
 #include "ui/screens/iscreen.hpp"
 #include "ui/ui_theme.hpp"
 #include "ui/utils.hpp"
@@ -27,16 +31,198 @@ private:
   const actions_vector_t *actions;
   size_t active_entry = 0;
   const std::string title = "Menu";
+  font_handle text_font{ theme::FONT_NAME_TEXT, theme::FONT_SIZE_TEXT };
+  font_handle title_font{ theme::FONT_NAME_TEXT, theme::FONT_SIZE_TEXT_SMALL };
+
+  // Number of entries declared above and below the visible window when the entry positions are known
+  static constexpr size_t OVERSCAN_ENTRIES = 2;
+
+  // Entry positions, reused while the menu contents stay the same so that each frame only needs a single layout pass.
+  // `entry_offsets` holds the prefix sums of the entry heights, so that entry `i` spans `entry_offsets[i]` to
+  // `entry_offsets[i + 1]`; `page_offsets[i]` is the offset of the page containing entry `i`. The owner of the actions
+  // calls invalidate_layout when it changes their texts, the size of the list is checked on every frame.
+  struct {
+    const actions_vector_t *actions = nullptr;
+    size_t screen_height = 0;
+    uint32_t font_generation = 0;
+    float scroll_container_height = 0.0f;
+    std::vector<float> entry_offsets{};
+    std::vector<float> page_offsets{};
+    bool valid = false;
+  } layout_cache;
+
+  // The widths of the words of the entry being measured, negative for line breaks
+  std::vector<float> measured_words{};
+
+  [[nodiscard]] bool is_layout_cache_valid(const display_controller_api &controller_api) const {
+    return layout_cache.valid && layout_cache.actions == actions &&
+           layout_cache.page_offsets.size() == actions->size() &&
+           layout_cache.screen_height == controller_api.get_screen_height() &&
+           layout_cache.font_generation == controller_api.get_font_generation();
+  }
+
+  /**
+   * Measure the height of a text once wrapped to the given width. Words are measured and wrapped the same way Clay
+   * does, so the height is known without declaring the text in a layout.
+   *
+   * @param controller_api The display controller API, whose text measurements are cached
+   * @param text The text to measure
+   * @param config The text config the text is laid out with
+   * @param space_width The width of a space in the text's font
+   * @param max_width The width available to the text, infinite if it's only broken on line breaks
+   * @return The height of the wrapped text
+   */
+  [[nodiscard]] float measure_wrapped_text_height(display_controller_api &controller_api,
+                                                  const std::string &text,
+                                                  Clay_TextElementConfig &config,
+                                                  const float space_width,
+                                                  const float max_width) {
+    auto &words = measured_words;
+    words.clear();
+    float line_width = 0.0f;
+    float unwrapped_width = 0.0f;
+    float longest_word_width = 0.0f;
+    float text_height = 0.0f;
+    bool has_newlines = false;
+    for (size_t start = 0, end = 0; end <= text.size(); end++) {
+      if (end < text.size() && text[end] != ' ' && text[end] != '\n')
+        continue;
+      measure_text_result_t word_size{ 0.0f, 0.0f };
+      if (end > start)
+        word_size = controller_api.clay_measure_text(text.data() + start, end - start, &config);
+      longest_word_width = std::max(longest_word_width, word_size.width);
+      text_height = std::max(text_height, word_size.height);
+
+      if (end == text.size()) {
+        if (end > start)
+          words.push_back(word_size.width);
+        line_width += word_size.width;
+      } else if (text[end] == ' ') {
+        // Spaces stick to the word before them
+        words.push_back(word_size.width + space_width);
+        line_width += word_size.width + space_width;
+      } else {
+        if (end > start)
+          words.push_back(word_size.width);
+        words.push_back(-1.0f);
+        unwrapped_width = std::max(unwrapped_width, line_width + word_size.width);
+        line_width = 0.0f;
+        has_newlines = true;
+      }
+      start = end + 1;
+    }
+    unwrapped_width = std::max(unwrapped_width, line_width) - config.letterSpacing;
+
+    const float line_height = config.lineHeight > 0 ? static_cast<float>(config.lineHeight) : text_height;
+    // The text shrinks to fit, but no further than its longest word
+    const float width = std::max(std::min(unwrapped_width, max_width), longest_word_width);
+    if (!has_newlines && unwrapped_width <= width)
+      return line_height;
+
+    size_t lines = 0;
+    line_width = 0.0f;
+    bool line_empty = true;
+    for (size_t i = 0; i < words.size();) {
+      const bool newline = words[i] < 0.0f;
+      const float word_width = newline ? 0.0f : words[i];
+      if (line_empty && line_width + word_width > width) {
+        // A word too long for a line gets one of its own
+        lines++;
+        i++;
+      } else if (newline || line_width + word_width > width) {
+        lines++;
+        if (line_empty || newline)
+          i++;
+        line_width = 0.0f;
+        line_empty = true;
+      } else {
+        line_width += word_width + config.letterSpacing;
+        line_empty = false;
+        i++;
+      }
+    }
+    if (!line_empty)
+      lines++;
+    return line_height * static_cast<float>(lines);
+  }
 
-  static float get_entry_y_offset(const size_t entry_index, const size_t count_from_entry = 0) {
-    assert(entry_index >= count_from_entry);
-    float offset = 0.0f;
-    for (size_t i = count_from_entry; i < entry_index; i++) {
-      const auto [boundingBox, found] = Clay_GetElementData(CLAY_IDI("MenuEntry", static_cast<uint32_t>(i)));
-      assert(found);
-      offset += boundingBox.height;
+  /**
+   * Compute the entry heights from their texts, for the scroll container of the layout that was just computed. Page
+   * breaks fill the rest of their page, so their height is derived from the entries before them.
+   */
+  void update_layout_cache(display_controller_api &controller_api, Clay_TextElementConfig &textCfg) {
+    const Clay_ScrollContainerData scroll_info = Clay_GetScrollContainerData(CLAY_ID("ScrollLayout"));
+    assert(scroll_info.found);
+    const float scroll_container_height = scroll_info.scrollContainerDimensions.height;
+    // All the text configs use the same font, so entries are as tall whichever one they're laid out with
+    const float text_width = scroll_info.scrollContainerDimensions.width - 2.0f * MENUENTRY_PADDING;
+    const float space_width = controller_api.clay_measure_text(" ", 1, &textCfg).width;
+
+    auto &offsets = layout_cache.entry_offsets;
+    offsets.assign(actions->size() + 1, 0.0f);
+    layout_cache.page_offsets.assign(actions->size(), 0.0f);
+    size_t last_page_break_index = 0;
+    float page_offset = 0.0f;
+    for (size_t i = 0; i < actions->size(); i++) {
+      layout_cache.page_offsets[i] = page_offset;
+
+      const auto &action = (*actions)[i];
+      float height;
+      if (is_a<actions::page_break>(action.get())) {
+        const float y_offset = offsets[i] - offsets[std::min(last_page_break_index + 1, i)];
+        const float fill_height = y_offset < scroll_container_height ? scroll_container_height - y_offset : 0.0f;
+        // A page break can't be shorter than its own padding
+        height = std::max(fill_height, 2.0f * MENUENTRY_PADDING);
+        last_page_break_index = i;
+        page_offset = offsets[i] + height;
+      } else {
+        // Entries that aren't multiline clip their text rather than wrap it
+        const float max_width = action->is_multiline() ? text_width : std::numeric_limits<float>::infinity();
+        height = measure_wrapped_text_height(controller_api, action->get_text(), textCfg, space_width, max_width) +
+                 2.0f * MENUENTRY_PADDING;
+      }
+      offsets[i + 1] = offsets[i] + height;
     }
-    return offset;
+
+    layout_cache.actions = actions;
+    layout_cache.screen_height = controller_api.get_screen_height();
+    layout_cache.font_generation = controller_api.get_font_generation();
+    layout_cache.scroll_container_height = scroll_container_height;
+    layout_cache.valid = true;
+  }
+
+  [[nodiscard]] float get_entry_y_offset(const size_t entry_index) const {
+    return layout_cache.entry_offsets[entry_index];
+  }
+
+  [[nodiscard]] float get_entry_height(const size_t entry_index) const {
+    return layout_cache.entry_offsets[entry_index + 1] - layout_cache.entry_offsets[entry_index];
+  }
+
+  /**
+   * Get the range of entries to declare for the given scroll offset: the entries intersecting the scroll container,
+   * the active entry and a few entries of overscan on either side. Nothing is declared while measuring, the entry
+   * heights are computed from their texts.
+   *
+   * @param scroll_y The vertical scroll offset of the scroll container
+   * @return The first entry to declare and one past the last one
+   */
+  [[nodiscard]] std::pair<size_t, size_t> get_visible_entries(const float scroll_y) const {
+    if (!layout_cache.valid)
+      return { 0, 0 };
+
+    const auto &offsets = layout_cache.entry_offsets;
+    const float top = -scroll_y;
+    const float bottom = top + layout_cache.scroll_container_height;
+    // Entry `i` is visible if it ends below the top of the window and starts above its bottom
+    size_t first = std::upper_bound(offsets.begin() + 1, offsets.end(), top) - offsets.begin() - 1;
+    size_t last = std::lower_bound(offsets.begin(), offsets.end() - 1, bottom) - offsets.begin();
+
+    first = std::min(first, active_entry);
+    last = std::max(last, active_entry + 1);
+    first = first > OVERSCAN_ENTRIES ? first - OVERSCAN_ENTRIES : 0;
+    last = std::min(last + OVERSCAN_ENTRIES, actions->size());
+    return { first, last };
   }
 
   void layout(display_controller_api &controller_api,
@@ -46,7 +232,8 @@ private:
               Clay_TextElementConfig &titleTextCfg,
               const Clay_BorderElementConfig &activeBorderCfg,
               const Clay_BorderElementConfig &disabledActiveBorderCfg,
-              const bool can_scroll_up = true) const {
+              const bool can_scroll_up = true,
+              const float scroll_y = 0.0f) const {
     ROOT_ELEMENT(&controller_api, CLAY_TOP_TO_BOTTOM) {
       if (controller_api.get_screen_height() > 64) {
         ui_add_header(&controller_api, title, &titleTextCfg, can_scroll_up, active_entry < actions->size() - 1);
@@ -60,12 +247,21 @@ private:
         .clip = {
           .horizontal = false,
           .vertical = true,
-          .childOffset = Clay_GetScrollOffset()
+          .childOffset = { 0.0f, scroll_y }
         },
       }) {
-        size_t index = 0;
-        size_t last_page_break_index = 0;
-        for (const auto &action : *actions) {
+        // Entries outside the visible window are replaced by spacers of the same total height
+        const auto [first_entry, end_entry] = get_visible_entries(scroll_y);
+        if (first_entry > 0) {
+          CLAY(CLAY_ID("MenuSpacerTop"), {
+            .layout = {
+              .sizing = { CLAY_SIZING_GROW(0), CLAY_SIZING_FIXED(get_entry_y_offset(first_entry)) },
+            },
+          }) {}
+        }
+
+        for (size_t index = first_entry; index < end_entry; index++) {
+          const auto &action = (*actions)[index];
           Clay_ElementDeclaration element_config;
           Clay_ElementId element_id;
           Clay_TextElementConfig *text_config;
@@ -100,23 +296,23 @@ private:
           }
 
           if (is_a<actions::page_break>(&*action)) {
-            const float y_offset = get_entry_y_offset(index, last_page_break_index + 1);
-            const Clay_ScrollContainerData scroll_info = Clay_GetScrollContainerData(CLAY_ID("ScrollLayout"));
-            assert(scroll_info.found);
-            const float scroll_container_height = scroll_info.scrollContainerDimensions.height;
-            if (y_offset < scroll_container_height) {
-              element_config.layout.sizing.height = CLAY_SIZING_FIXED(scroll_container_height - y_offset);
-            } else {
-              element_config.layout.sizing.height = CLAY_SIZING_FIXED(0);
-            }
-
-            last_page_break_index = index;
+            element_config.layout.sizing.height = CLAY_SIZING_FIXED(get_entry_height(index));
           }
 
           CLAY(element_id, element_config) {
             CLAY_TEXT(to_clay_string(action->get_text()), text_config);
           }
-          index++;
+        }
+
+        if (layout_cache.valid && end_entry < actions->size()) {
+          CLAY(CLAY_ID("MenuSpacerBottom"), {
+            .layout = {
+              .sizing = {
+                CLAY_SIZING_GROW(0),
+                CLAY_SIZING_FIXED(get_entry_y_offset(actions->size()) - get_entry_y_offset(end_entry))
+              },
+            },
+          }) {}
         }
       }
 
@@ -142,7 +338,7 @@ public:
   void render(display_controller_api &controller_api) override {
     auto textCfg = (Clay_TextElementConfig) {
       .textColor = ui::theme::COLOR_TEXT,
-      .fontId = controller_api.get_font(theme::FONT_NAME_TEXT, theme::FONT_SIZE_TEXT).value_or(0),
+      .fontId = text_font.get(controller_api),
       .fontSize = theme::FONT_SIZE_TEXT,
       .letterSpacing = 0,
       .lineHeight = 0,
@@ -152,7 +348,7 @@ public:
 
     auto activeTextCfg = (Clay_TextElementConfig) {
       .textColor = ui::theme::COLOR_ACTIVE_TEXT,
-      .fontId = controller_api.get_font(theme::FONT_NAME_TEXT, theme::FONT_SIZE_TEXT).value_or(0),
+      .fontId = text_font.get(controller_api),
       .fontSize = theme::FONT_SIZE_TEXT,
       .letterSpacing = 0,
       .lineHeight = 0,
@@ -162,7 +358,7 @@ public:
 
     auto disabledTextCfg = (Clay_TextElementConfig) {
       .textColor = ui::theme::COLOR_DISABLED_ACTIVE_TEXT,
-      .fontId = controller_api.get_font(theme::FONT_NAME_TEXT, theme::FONT_SIZE_TEXT).value_or(0),
+      .fontId = text_font.get(controller_api),
       .fontSize = theme::FONT_SIZE_TEXT,
       .letterSpacing = 0,
       .lineHeight = 0,
@@ -172,7 +368,7 @@ public:
 
     auto titleTextCfg = (Clay_TextElementConfig) {
       .textColor = ui::theme::COLOR_TEXT,
-      .fontId = controller_api.get_font(ui::theme::FONT_NAME_TEXT, ui::theme::FONT_SIZE_TEXT_SMALL).value_or(0),
+      .fontId = title_font.get(controller_api),
       .fontSize = ui::theme::FONT_SIZE_TEXT_SMALL,
       .wrapMode = CLAY_TEXT_WRAP_WORDS,
       .textAlignment = CLAY_TEXT_ALIGN_CENTER,
@@ -196,48 +392,40 @@ public:
                  0 },
     };
 
-    // Lay out once to compute scroll positions
-    Clay_BeginLayout();
-    layout(controller_api,
-           textCfg,
-           activeTextCfg,
-           disabledTextCfg,
-           titleTextCfg,
-           activeBorderCfg,
-           disabledActiveBorderCfg);
-
-    float last_page_break_y_offset = 0.0f;
-    for (ssize_t i = active_entry - 1; i >= 0; i--) {
-      if (is_a<actions::page_break>((*actions)[i].get())) {
-        last_page_break_y_offset = get_entry_y_offset(i + 1);
-        break;
-      }
+    // Only lay out twice when the entry heights from a previous frame can't be reused. The first pass only sizes the
+    // scroll container, the entries aren't declared.
+    if (!is_layout_cache_valid(controller_api)) {
+      layout_cache.valid = false;
+      Clay_BeginLayout();
+      layout(controller_api,
+             textCfg,
+             activeTextCfg,
+             disabledTextCfg,
+             titleTextCfg,
+             activeBorderCfg,
+             disabledActiveBorderCfg);
+      Clay_EndLayout();
+      update_layout_cache(controller_api, textCfg);
     }
 
+    const float last_page_break_y_offset = layout_cache.page_offsets[active_entry];
     const float active_entry_y_offset_from_top = get_entry_y_offset(active_entry);
     const float active_entry_y_offset_from_page_break = active_entry_y_offset_from_top - last_page_break_y_offset;
+    const float active_entry_height = get_entry_height(active_entry);
+    const float scroll_container_height = layout_cache.scroll_container_height;
 
-    const Clay_ScrollContainerData scroll_info = Clay_GetScrollContainerData(CLAY_ID("ScrollLayout"));
-    Clay_ElementData active_entry = Clay_GetElementData(CLAY_ID("ActiveMenuEntry"));
-    assert(scroll_info.found);
-    assert(active_entry.found);
-
+    float scroll_y;
     bool can_scroll_up = false;
-    if (active_entry_y_offset_from_page_break + active_entry.boundingBox.height >
-        scroll_info.scrollContainerDimensions.height) {
-      scroll_info.scrollPosition->y = -static_cast<int>(active_entry_y_offset_from_page_break +
-                                                        last_page_break_y_offset + active_entry.boundingBox.height -
-                                                        scroll_info.scrollContainerDimensions.height + 1);
+    if (active_entry_y_offset_from_page_break + active_entry_height > scroll_container_height) {
+      scroll_y = -static_cast<float>(static_cast<int>(active_entry_y_offset_from_page_break + last_page_break_y_offset +
+                                                      active_entry_height - scroll_container_height + 1));
       can_scroll_up = true;
     } else {
-      scroll_info.scrollPosition->y = -static_cast<int>(last_page_break_y_offset);
+      scroll_y = -static_cast<float>(static_cast<int>(last_page_break_y_offset));
       can_scroll_up = last_page_break_y_offset > 0.0f;
     }
-    Clay_EndLayout();
 
-    // Now lay out again with the correct scroll position
     Clay_BeginLayout();
-
     layout(controller_api,
            textCfg,
            activeTextCfg,
@@ -245,11 +433,11 @@ public:
            titleTextCfg,
            activeBorderCfg,
            disabledActiveBorderCfg,
-           can_scroll_up);
+           can_scroll_up,
+           scroll_y);
     controller_api.clay_render(Clay_EndLayout());
 
-    active_entry = Clay_GetElementData(CLAY_ID("ActiveMenuEntry"));
-    assert(active_entry.found);
+    assert(Clay_GetElementData(CLAY_ID("ActiveMenuEntry")).found);
   }
 
   void handle_keypress(display_controller_api &controller_api, int button) override {
@@ -264,8 +452,11 @@ public:
     }
     case BUTTON_POWER: {
       const auto &action = actions->at(active_entry);
-      if (action->is_selectable() && action->is_enabled())
+      if (action->is_selectable() && action->is_enabled()) {
+        // Selecting may change the text of the action, or replace this screen
+        invalidate_layout();
         action->select();
+      }
       break;
     }
     default:
@@ -275,6 +466,11 @@ public:
 
   size_t get_active_entry() const { return active_entry; }
 
+  /**
+   * Recompute the entry heights at the next render. Must be called when the texts of the actions are changed.
+   */
+  void invalidate_layout() { layout_cache.valid = false; }
+
   void set_active_entry(const size_t entry_index) {
     assert(entry_index < actions->size());
     active_entry = entry_index;
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string_view>
+
+#include "apps/app_api.hpp"
+#include "clay.hpp"
+#include "fonts/poppins_12.hpp"
+#include "fonts/poppins_8.hpp"
+#include "template_utils.hpp"
+#include "ui/ui_theme.hpp"
+
+namespace ui {
+
+static_assert(std::string_view(fonts::Poppins_12.name) == theme::FONT_NAME_TEXT &&
+                fonts::Poppins_12.size == theme::FONT_SIZE_TEXT,
+              "Static text metrics assume the theme text font is Poppins 12");
+static_assert(std::string_view(fonts::Poppins_8.name) == theme::FONT_NAME_TEXT &&
+                fonts::Poppins_8.size == theme::FONT_SIZE_TEXT_SMALL,
+              "Static text metrics assume the small theme text font is Poppins 8");
+
+/**
+ * Dimensions of a compile-time string in each of the theme's text fonts, computed at compile time.
+ *
+ * @tparam Text The string to measure
+ */
+template<StringLiteral Text>
+struct static_text {
+  static constexpr std::string_view text{ Text.value };
+  static constexpr BitmapFont::TextMetrics regular = fonts::Poppins_12.measure(text);
+  static constexpr BitmapFont::TextMetrics small = fonts::Poppins_8.measure(text);
+};
+
+/**
+ * Measure a compile-time string. Text in the theme fonts uses the dimensions precomputed by `static_text`, any other
+ * font falls back to the controller's runtime measurement.
+ *
+ * @tparam Text The string to measure
+ * @param controller_api The controller API object
+ * @param config The text element configuration
+ * @return The measured dimensions
+ */
+template<StringLiteral Text>
+measure_text_result_t measure_static_text(const app_api_t controller_api, Clay_TextElementConfig *config) {
+  using metrics = static_text<Text>;
+  if (config->fontSize == theme::FONT_SIZE_TEXT)
+    return { static_cast<float>(metrics::regular.width), static_cast<float>(metrics::regular.height) };
+  if (config->fontSize == theme::FONT_SIZE_TEXT_SMALL)
+    return { static_cast<float>(metrics::small.width), static_cast<float>(metrics::small.height) };
+  return controller_api->clay_measure_text(metrics::text.data(), metrics::text.size(), config);
+}
+
+} // namespace ui
@@ -2,6 +2,7 @@
 
 #include "clay.hpp"
 #include "symbols.h"
+#include "ui/static_text.hpp"
 #include "ui/ui_theme.hpp"
 
 #define ROOT_ELEMENT_SIZING(_ctrl)                                      \
@@ -81,7 +82,7 @@ inline void ui_add_header(app_api_t controller_api,
 
     // Left horizontal line
     const bool scroll = can_scroll_up || can_scroll_down;
-    const auto [caretWidth, caretHeight] = controller_api->clay_measure_text(GLYPH_CARET_UP, textCfg);
+    const auto [caretWidth, caretHeight] = ui::measure_static_text<GLYPH_CARET_UP>(controller_api, textCfg);
     CLAY(CLAY_ID("HeaderRightLine"), {
       .layout = {
         .sizing = { CLAY_SIZING_GROW(), CLAY_SIZING_FIXED(textHeight) },
@@ -8,6 +8,7 @@
 #endif
 
 #define FONT_NOT_FOUND ((uint16_t) (~0))
+#define TIMER_SLACK_DEFAULT ((uint32_t) (~0))
 
 #define FN_TYPE(_name, _ret, ...) _ret (*_name)(__VA_ARGS__)
 #define DECLARE_FN_TYPE(_name, _ret, ...) typedef FN_TYPE(_name, _ret, __VA_ARGS__)
@@ -57,6 +58,25 @@ typedef struct measure_text_result {
   float width, height;
 } measure_text_result_t;
 
+typedef enum app_call_kind {
+  APP_CALL_ENTER = 0,
+  APP_CALL_LEAVE,
+  APP_CALL_KEYPRESS,
+  APP_CALL_TIMER,
+  APP_CALL_WAKE_STATE,
+  APP_CALL_RENDER, // rasterizing the frames the app submitted through clay_render
+  APP_CALL_TASK, // background tasks, on the worker threads
+  APP_CALL_TASK_DONE,
+  APP_CALL_KIND_COUNT
+} app_call_kind_t;
+
+typedef struct app_call_stats {
+  uint32_t count;
+  uint32_t max_us;
+  uint32_t p99_us;
+  uint64_t total_us;
+} app_call_stats_t;
+
 /**
  * App teardown function
  *
@@ -216,9 +236,26 @@ EXPORT size_t app_api_get_screen_height(c_app_api_t controller_api);
  */
 EXPORT uint16_t app_api_get_font(c_app_api_t controller_api, const char *font_name, int font_size);
 
+/**
+ * Get the font registry generation
+ *
+ * The generation changes whenever fonts are added to the registry. Font IDs resolved with `app_api_get_font` may be
+ * cached for as long as the generation stays the same.
+ *
+ * @param controller_api The controller API object
+ * @return The font registry generation
+ */
+EXPORT uint32_t app_api_get_font_generation(c_app_api_t controller_api);
+
 /**
  * Render a frame using Clay rendering commands
  *
+ * Text is copied, but the frame may be rasterized after this returns, up to the next frame slot. The images it
+ * references must stay alive and unchanged until the app renders its next frame or leaves.
+ *
+ * Images are compared by address: parts of the screen whose render commands are the same as in the previous frame
+ * aren't redrawn, so an image that was changed in place is only shown once it's passed at a different address.
+ *
  * @param controller_api The controller API object
  * @param cmds The Clay rendering commands
  */
@@ -233,6 +270,25 @@ EXPORT void app_api_clay_render(app_api_t controller_api, const Clay_RenderComma
  */
 EXPORT void app_api_draw_frame(app_api_t controller_api, const uint16_t *buf, size_t buf_size);
 
+/**
+ * Show a toast banner at the bottom of the screen, over the app's current frame.
+ *
+ * The banner is composited by the controller whenever the screen is refreshed, so the app doesn't need to render
+ * again to show, update or hide it. Showing a new toast replaces the current one.
+ *
+ * @param controller_api The controller API object
+ * @param text The text to show
+ * @param duration_ms How long to show the toast for, or 0 to show it until `app_api_hide_toast` is called
+ */
+EXPORT void app_api_show_toast(app_api_t controller_api, const char *text, uint32_t duration_ms);
+
+/**
+ * Hide the current toast banner, if any
+ *
+ * @param controller_api The controller API object
+ */
+EXPORT void app_api_hide_toast(app_api_t controller_api);
+
 /**
  * Return to the main menu, leaving the current app. `on_leave` will be called before returning.
  *
@@ -282,9 +338,29 @@ EXPORT uint32_t app_api_schedule_timer(app_api_t controller_api,
                                        void (*callback)(void *userptr),
                                        void *userptr);
 
+/**
+ * Register a timer callback that may run up to slack_ms late. Timers whose windows overlap are run in the same wakeup,
+ * and their frames are sent to the screen once.
+ *
+ * @param controller_api The controller API object
+ * @param time Time in milliseconds until the timer fires
+ * @param repeat Whether the timer should repeat
+ * @param slack_ms How late the timer may fire, in milliseconds, or TIMER_SLACK_DEFAULT to use the default for the
+ *                 current wake state
+ * @param callback The callback function to call when the timer fires
+ * @param userptr A user pointer to pass to the callback function
+ * @return The timer ID
+ */
+EXPORT uint32_t app_api_schedule_timer_with_slack(app_api_t controller_api,
+                                                  uint32_t time,
+                                                  uint32_t repeat,
+                                                  uint32_t slack_ms,
+                                                  void (*callback)(void *userptr),
+                                                  void *userptr);
+
 /**
  * Cancel a previously registered timer
- * Note: it doesn't appear to be possible to cancel a timer from within its own callback.
+ * A repeating timer may cancel itself from its own callback, it won't run again.
  *
  * @param controller_api The controller API object
  * @param timer_id The ID of the timer to cancel
@@ -292,6 +368,55 @@ EXPORT uint32_t app_api_schedule_timer(app_api_t controller_api,
  */
 EXPORT uint32_t app_api_cancel_timer(app_api_t controller_api, uint32_t timer_id);
 
+/**
+ * Background task function
+ *
+ * Called on one of the controller's worker threads, while the controller and the apps keep running. It must not call
+ * the controller API, and must synchronize access to anything it shares with the app's other callbacks.
+ *
+ * @param userptr The user pointer provided when posting the task
+ */
+DECLARE_FN_TYPE(app_task_fn_t, void, void *userptr);
+
+/**
+ * Background task completion callback
+ *
+ * Called on the controller's thread, like the app's other callbacks, once the task returned or was canceled.
+ *
+ * @param userptr The user pointer provided when posting the task
+ * @param canceled Whether the task was canceled, in which case it may not have run at all
+ */
+DECLARE_FN_TYPE(app_task_done_fn_t, void, void *userptr, bool canceled);
+
+/**
+ * Run a function on a worker thread, for work that would otherwise hold up rendering and input.
+ *
+ * Each app may only have a few tasks queued or running at once. They're canceled when the app is left or unloaded;
+ * tasks that are already running aren't interrupted, but the app is only unloaded once they return. The completion
+ * callback is called exactly once for every task that was posted successfully.
+ *
+ * Must be called from the app's callbacks.
+ *
+ * @param controller_api The controller API object
+ * @param task_fn The function to run on a worker thread
+ * @param done_fn The function to call on the controller's thread once the task is done
+ * @param userptr A user pointer to pass to both functions
+ * @return The task ID, or 0 if the task couldn't be queued
+ */
+EXPORT uint32_t app_api_post_background_task(app_api_t controller_api,
+                                             app_task_fn_t task_fn,
+                                             app_task_done_fn_t done_fn,
+                                             void *userptr);
+
+/**
+ * Cancel a background task. Its completion callback is called with canceled set, once it returns if it was running.
+ *
+ * @param controller_api The controller API object
+ * @param task_id The ID of the task to cancel
+ * @return 0 on success, non-zero if the task was already done or canceled
+ */
+EXPORT uint32_t app_api_cancel_background_task(app_api_t controller_api, uint32_t task_id);
+
 /**
  * Measure the dimensions of a text string with the given configuration, using Clay's text measurement.
  *
@@ -306,6 +431,37 @@ EXPORT measure_text_result_t app_api_clay_measure_text(app_api_t controller_api,
                                                        size_t length,
                                                        Clay_TextElementConfig *config);
 
+/**
+ * Get the number of apps known to the controller, including the main menu and apps that aren't loaded
+ *
+ * @param controller_api The controller API object
+ * @return The number of apps
+ */
+EXPORT size_t app_api_get_app_count(c_app_api_t controller_api);
+
+/**
+ * Get the name of an app
+ *
+ * @param controller_api The controller API object
+ * @param app_index The index of the app, below `app_api_get_app_count`
+ * @return The name of the app, valid until the apps change, or NULL if the index is out of range
+ */
+EXPORT const char *app_api_get_app_name(c_app_api_t controller_api, size_t app_index);
+
+/**
+ * Get how much time an app spent in one kind of call. The stats are kept across app reloads.
+ *
+ * @param controller_api The controller API object
+ * @param app_index The index of the app, below `app_api_get_app_count`
+ * @param kind The kind of call
+ * @param stats Output parameter to receive the stats
+ * @return Whether the app and kind were valid
+ */
+EXPORT bool app_api_get_app_call_stats(c_app_api_t controller_api,
+                                       size_t app_index,
+                                       app_call_kind_t kind,
+                                       app_call_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -20,6 +20,16 @@ EXPORT uint32_t app_api_schedule_stdfn_timer(app_api_t controller_api,
                                              uint32_t repeat,
                                              std::function<void()> &&callback);
 
+EXPORT uint32_t app_api_schedule_stdfn_timer_with_slack(app_api_t controller_api,
+                                                        uint32_t time,
+                                                        uint32_t repeat,
+                                                        uint32_t slack_ms,
+                                                        std::function<void()> &&callback);
+
+EXPORT uint32_t app_api_post_stdfn_background_task(app_api_t controller_api,
+                                                   std::function<void()> &&task,
+                                                   std::function<void(bool canceled)> &&done);
+
 }
 
 struct display_controller_api {
@@ -58,9 +68,22 @@ struct display_controller_api {
     return result;
   };
 
+  /**
+   * Get the font registry generation. Font IDs may be cached for as long as it stays the same.
+   *
+   * @return The font registry generation
+   */
+  [[nodiscard]] uint32_t get_font_generation() const { return app_api_get_font_generation(this); }
+
   /**
    * Render a frame using Clay rendering commands
    *
+   * Text is copied, but the frame may be rasterized after this returns, up to the next frame slot. The images it
+   * references must stay alive and unchanged until the app renders its next frame or leaves.
+   *
+   * Images are compared by address: parts of the screen whose render commands are the same as in the previous frame
+   * aren't redrawn, so an image that was changed in place is only shown once it's passed at a different address.
+   *
    * @param cmds The Clay rendering commands
    */
   void clay_render(const Clay_RenderCommandArray &cmds) { app_api_clay_render(this, &cmds); }
@@ -79,6 +102,22 @@ struct display_controller_api {
    */
   void draw_frame(const std::span<const uint16_t> &buf) { app_api_draw_frame(this, buf.data(), buf.size()); }
 
+  /**
+   * Show a toast banner at the bottom of the screen, over the app's current frame. The app doesn't need to render again
+   * to show, update or hide it.
+   *
+   * @param text The text to show
+   * @param duration_ms How long to show the toast for, or 0 to show it until `hide_toast` is called
+   */
+  void show_toast(const std::string &text, const uint32_t duration_ms = 2000) {
+    app_api_show_toast(this, text.c_str(), duration_ms);
+  }
+
+  /**
+   * Hide the current toast banner, if any
+   */
+  void hide_toast() { app_api_hide_toast(this); }
+
   /**
    * Return to the main menu, leaving the current app. `on_leave` will be called before returning.
    */
@@ -130,10 +169,15 @@ struct display_controller_api {
    * @param repeat Whether the timer should repeat
    * @param callback The callback function to call when the timer fires
    * @param userptr A user pointer to pass to the callback function
+   * @param slack_ms How late the timer may fire, in milliseconds, so it can share a wakeup with other timers
    * @return The timer ID
    */
-  uint32_t schedule_timer(const uint32_t time, const uint32_t repeat, void (*callback)(void *userptr), void *userptr) {
-    return app_api_schedule_timer(this, time, repeat, callback, userptr);
+  uint32_t schedule_timer(const uint32_t time,
+                          const uint32_t repeat,
+                          void (*callback)(void *userptr),
+                          void *userptr,
+                          const uint32_t slack_ms = TIMER_SLACK_DEFAULT) {
+    return app_api_schedule_timer_with_slack(this, time, repeat, slack_ms, callback, userptr);
   }
 
   /**
@@ -142,21 +186,58 @@ struct display_controller_api {
    * @param time Time in milliseconds until the timer fires
    * @param repeat Whether the timer should repeat
    * @param callback The callback function to call when the timer fires
+   * @param slack_ms How late the timer may fire, in milliseconds, so it can share a wakeup with other timers
    * @return The timer ID
    */
-  uint32_t schedule_timer(const uint32_t time, const uint32_t repeat, std::function<void()> &&callback) {
-    return priv_api::app_api_schedule_stdfn_timer(this, time, repeat, std::move(callback));
+  uint32_t schedule_timer(const uint32_t time,
+                          const uint32_t repeat,
+                          std::function<void()> &&callback,
+                          const uint32_t slack_ms = TIMER_SLACK_DEFAULT) {
+    return priv_api::app_api_schedule_stdfn_timer_with_slack(this, time, repeat, slack_ms, std::move(callback));
   }
 
   /**
    * Cancel a previously registered timer.
-   * Note: it doesn't appear to be possible to cancel a timer from within its own callback.
+   * A repeating timer may cancel itself from its own callback, it won't run again.
    *
    * @param timer_id The ID of the timer to cancel
    * @return 0 on success, non-zero on failure
    */
   uint32_t cancel_timer(uint32_t timer_id) { return app_api_cancel_timer(this, timer_id); }
 
+  /**
+   * Run a function on a worker thread. The task must not call the controller API, and is canceled when the app is left
+   * or unloaded. Must be called from the app's callbacks.
+   *
+   * @param task_fn The function to run on a worker thread
+   * @param done_fn The function to call on the controller's thread once the task returned or was canceled
+   * @param userptr A user pointer to pass to both functions
+   * @return The task ID, or 0 if the app has too many tasks in flight
+   */
+  uint32_t post_background_task(const app_task_fn_t task_fn, const app_task_done_fn_t done_fn, void *userptr) {
+    return app_api_post_background_task(this, task_fn, done_fn, userptr);
+  }
+
+  /**
+   * Run a function on a worker thread. The task must not call the controller API, and is canceled when the app is left
+   * or unloaded. Must be called from the app's callbacks.
+   *
+   * @param task The function to run on a worker thread
+   * @param done The function to call on the controller's thread once the task returned or was canceled
+   * @return The task ID, or 0 if the app has too many tasks in flight
+   */
+  uint32_t post_background_task(std::function<void()> &&task, std::function<void(bool canceled)> &&done) {
+    return priv_api::app_api_post_stdfn_background_task(this, std::move(task), std::move(done));
+  }
+
+  /**
+   * Cancel a background task. Its completion callback is called with canceled set, once it returns if it was running.
+   *
+   * @param task_id The ID of the task to cancel
+   * @return 0 on success, non-zero if the task was already done or canceled
+   */
+  uint32_t cancel_background_task(const uint32_t task_id) { return app_api_cancel_background_task(this, task_id); }
+
   /**
    * Measure the dimensions of a text string with the given configuration, using Clay's text measurement.
    *
@@ -179,6 +260,41 @@ struct display_controller_api {
   measure_text_result_t clay_measure_text(const std::string &text, Clay_TextElementConfig *config) {
     return app_api_clay_measure_text(this, text.c_str(), text.size(), config);
   }
+
+  /**
+   * Get the number of apps known to the controller, including the main menu and apps that aren't loaded
+   *
+   * @return The number of apps
+   */
+  [[nodiscard]] size_t get_app_count() const { return app_api_get_app_count(this); }
+
+  /**
+   * Get the name of an app
+   *
+   * @param app_index The index of the app, below `get_app_count`
+   * @return The name of the app, or nothing if the index is out of range
+   */
+  [[nodiscard]] std::optional<std::string> get_app_name(const size_t app_index) const {
+    const char *name = app_api_get_app_name(this, app_index);
+    if (name == nullptr)
+      return std::nullopt;
+    return name;
+  }
+
+  /**
+   * Get how much time an app spent in one kind of call. The stats are kept across app reloads.
+   *
+   * @param app_index The index of the app, below `get_app_count`
+   * @param kind The kind of call
+   * @return The stats, or nothing if the app or kind is invalid
+   */
+  [[nodiscard]] std::optional<app_call_stats_t> get_app_call_stats(const size_t app_index,
+                                                                   const app_call_kind_t kind) const {
+    app_call_stats_t stats;
+    if (!app_api_get_app_call_stats(this, app_index, kind, &stats))
+      return std::nullopt;
+    return stats;
+  }
 };
 
 template<typename T, typename Arg>